@@ -0,0 +1,475 @@
+#include "encode.h"
+#include "decode.h"
+#include "corpus.h"
+#include "common.h"
+#include "load_stb.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_writer.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Hashes are compared by decoding both at this size
+#define PSNR_SIZE 32
+
+// Fast decoders are compared at this output width, keeping the aspect ratio
+#define DECODE_WIDTH 256
+
+// Batch decoders are compared at this size, timing this many rounds
+#define BATCH_DECODE_SIZE 32
+#define BATCH_DECODE_ROUNDS 100
+
+// Quality of the generated JPEGs and their EXIF thumbnails
+#define SYNTHETIC_JPEG_QUALITY 90
+
+static const int syntheticSizes[][2] = { { 256, 256 }, { 640, 480 }, { 1920, 1080 }, { 300, 1200 } };
+
+#define COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+// The encoder modes, then the decoder modes
+enum { MODE_FIXED_POINT, MODE_STREAMING, MODE_BATCH, MODE_DOWNSCALED, MODE_THUMBNAIL,
+	MODE_DECODE_FIXED_POINT, MODE_DECODE_MAX_PUNCH, MODE_DECODE_ARRAYS, MODE_DECODE_SLAB, MODES };
+#define FIRST_DECODE_MODE MODE_DECODE_FIXED_POINT
+
+typedef struct {
+	const char *name;
+	long images;
+	long characters, mismatchedCharacters, differingHashes;
+	double maxError;
+	double minPsnr, psnrSum;
+	long psnrCount; // identical results have no PSNR
+	double referenceSeconds, modeSeconds;
+} ModeReport;
+
+typedef struct {
+	int xComponents, yComponents;
+	ModeReport modes[MODES];
+	// The reference hash of every image, for the batch decoders
+	char **hashes;
+	int hashCount;
+} Report;
+
+typedef struct {
+	uint8_t *data;
+	size_t length, capacity;
+	int failed;
+} Buffer;
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int decode83(const char *string, int length) {
+	static const char characters[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz#$%*+,-.:;=?@[]^_{|}~";
+	int value = 0;
+	for(int i = 0; i < length; i++) value = value * 83 + (int)(strchr(characters, string[i]) - characters);
+	return value;
+}
+
+// The linear coefficients a hash encodes, in the layout of blurHashFactorsForPixels.
+// Returns the number of components.
+static int hashCoefficients(const char *hash, float coefficients[][3]) {
+	int sizeFlag = decode83(hash, 1);
+	int components = (sizeFlag % 9 + 1) * (sizeFlag / 9 + 1);
+	float maximumValue = (float)(decode83(hash + 1, 1) + 1) / 166;
+
+	int dc = decode83(hash + 2, 4);
+	coefficients[0][0] = sRGBToLinear(dc >> 16);
+	coefficients[0][1] = sRGBToLinear((dc >> 8) & 255);
+	coefficients[0][2] = sRGBToLinear(dc & 255);
+
+	for(int i = 1; i < components; i++) {
+		int ac = decode83(hash + 4 + 2 * i, 2);
+		coefficients[i][0] = signPow(((float)(ac / (19 * 19)) - 9) / 9, 2) * maximumValue;
+		coefficients[i][1] = signPow(((float)(ac / 19 % 19) - 9) / 9, 2) * maximumValue;
+		coefficients[i][2] = signPow(((float)(ac % 19) - 9) / 9, 2) * maximumValue;
+	}
+	return components;
+}
+
+static void addPsnr(ModeReport *mode, const uint8_t *reference, const uint8_t *pixels, size_t bytes) {
+	double squares = 0;
+	for(size_t i = 0; i < bytes; i++) {
+		int difference = abs(reference[i] - pixels[i]);
+		squares += difference * difference;
+	}
+	if(squares == 0) return;
+	double psnr = 10 * log10(255.0 * 255.0 * bytes / squares);
+	if(mode->psnrCount == 0 || psnr < mode->minPsnr) mode->minPsnr = psnr;
+	mode->psnrSum += psnr;
+	mode->psnrCount++;
+}
+
+static void compareHashes(ModeReport *mode, const char *reference, const char *hash, double referenceSeconds, double modeSeconds) {
+	size_t length = strlen(reference);
+	mode->images++;
+	mode->characters += length;
+	mode->referenceSeconds += referenceSeconds;
+	mode->modeSeconds += modeSeconds;
+	if(strcmp(reference, hash) == 0) return;
+
+	mode->differingHashes++;
+	for(size_t i = 0; i < length; i++) mode->mismatchedCharacters += reference[i] != hash[i];
+
+	float referenceCoefficients[81][3], coefficients[81][3];
+	int components = hashCoefficients(reference, referenceCoefficients);
+	hashCoefficients(hash, coefficients);
+	for(int i = 0; i < components; i++) {
+		for(int c = 0; c < 3; c++) {
+			double error = fabs(referenceCoefficients[i][c] - coefficients[i][c]);
+			if(error > mode->maxError) mode->maxError = error;
+		}
+	}
+
+	uint8_t referencePixels[PSNR_SIZE * PSNR_SIZE * 3], pixels[PSNR_SIZE * PSNR_SIZE * 3];
+	decodeToArray(reference, PSNR_SIZE, PSNR_SIZE, 1, 3, referencePixels);
+	decodeToArray(hash, PSNR_SIZE, PSNR_SIZE, 1, 3, pixels);
+	addPsnr(mode, referencePixels, pixels, sizeof(pixels));
+}
+
+static const char *blurHashForPixelsStreaming(int xComponents, int yComponents, int width, int height, uint8_t *rgb, size_t bytesPerRow) {
+	BlurHashEncoder *encoder = blurHashEncoderBegin(xComponents, yComponents, width, height);
+	if(!encoder) return NULL;
+	blurHashEncoderPushRows(encoder, rgb, height, bytesPerRow);
+	return blurHashEncoderFinish(encoder);
+}
+
+// Box filter by 1 << shift, for the EXIF thumbnails of the generated JPEGs
+static uint8_t *downscale(const uint8_t *rgb, int width, int height, int shift, int *scaledWidth, int *scaledHeight) {
+	int scale = 1 << shift;
+	*scaledWidth = (width + scale - 1) / scale;
+	*scaledHeight = (height + scale - 1) / scale;
+	uint8_t *scaled = malloc((size_t)*scaledWidth * *scaledHeight * 3);
+	if(!scaled) return NULL;
+
+	for(int y = 0; y < *scaledHeight; y++) {
+		for(int x = 0; x < *scaledWidth; x++) {
+			int sums[3] = { 0, 0, 0 }, count = 0;
+			for(int dy = 0; dy < scale && y * scale + dy < height; dy++) {
+				for(int dx = 0; dx < scale && x * scale + dx < width; dx++) {
+					const uint8_t *pixel = rgb + ((size_t)(y * scale + dy) * width + x * scale + dx) * 3;
+					sums[0] += pixel[0];
+					sums[1] += pixel[1];
+					sums[2] += pixel[2];
+					count++;
+				}
+			}
+			for(int c = 0; c < 3; c++) scaled[((size_t)y * *scaledWidth + x) * 3 + c] = (sums[c] + count / 2) / count;
+		}
+	}
+	return scaled;
+}
+
+static void comparePixels(ModeReport *mode, const uint8_t *referencePixels, const uint8_t *pixels, size_t bytes) {
+	mode->images++;
+	for(size_t i = 0; i < bytes; i++) {
+		double error = abs(referencePixels[i] - pixels[i]);
+		if(error > mode->maxError) mode->maxError = error;
+	}
+	addPsnr(mode, referencePixels, pixels, bytes);
+}
+
+// Decodes hash with decodeToArray and decodeToArrayFixedPoint and adds the difference to mode
+static void compareDecoders(ModeReport *mode, const char *hash, int width, int height, int punch, uint8_t *referencePixels, uint8_t *pixels) {
+	double t0 = now();
+	decodeToArray(hash, width, height, punch, 3, referencePixels);
+	mode->referenceSeconds += now() - t0;
+	t0 = now();
+	decodeToArrayFixedPoint(hash, width, height, punch, 3, pixels);
+	mode->modeSeconds += now() - t0;
+	comparePixels(mode, referencePixels, pixels, (size_t)width * height * 3);
+}
+
+static void bufferWrite(void *context, void *data, int size) {
+	Buffer *buffer = context;
+	if(buffer->failed) return;
+	if(buffer->length + size > buffer->capacity) {
+		size_t capacity = buffer->capacity ? buffer->capacity * 2 : 65536;
+		while(capacity < buffer->length + size) capacity *= 2;
+		uint8_t *grown = realloc(buffer->data, capacity);
+		if(!grown) {
+			buffer->failed = 1;
+			return;
+		}
+		buffer->data = grown;
+		buffer->capacity = capacity;
+	}
+	memcpy(buffer->data + buffer->length, data, size);
+	buffer->length += size;
+}
+
+static void bufferWriteInt(Buffer *buffer, unsigned int value, int bytes) {
+	uint8_t le[4];
+	for(int i = 0; i < bytes; i++) le[i] = (uint8_t)(value >> (8 * i));
+	bufferWrite(buffer, le, bytes);
+}
+
+/*
+	syntheticJpeg : Encodes a generated image as a baseline JPEG with an EXIF thumbnail,
+					box-filtered by the scale the reduced-scale loader would pick, so that
+					the loader modes run on the generated corpus too.
+	Returns : The file, which the caller frees, or NULL on failure.
+*/
+static uint8_t *syntheticJpeg(int xComponents, int yComponents, const uint8_t *rgb, int width, int height, size_t *length) {
+	Buffer image = { 0 }, thumbnail = { 0 };
+	stbi_write_jpg_to_func(bufferWrite, &image, width, height, 3, rgb, SYNTHETIC_JPEG_QUALITY);
+
+	int shift = loadDownscaleShift(xComponents, yComponents, width, height);
+	int thumbnailWidth, thumbnailHeight;
+	uint8_t *scaled = downscale(rgb, width, height, shift, &thumbnailWidth, &thumbnailHeight);
+	if(scaled) stbi_write_jpg_to_func(bufferWrite, &thumbnail, thumbnailWidth, thumbnailHeight, 3, scaled, SYNTHETIC_JPEG_QUALITY);
+	free(scaled);
+
+	// SOI, then an APP1 segment with a little-endian TIFF header, an empty IFD0
+	// and an IFD1 pointing at the thumbnail, then the rest of the image
+	const size_t tiffHeader = 8 + 2 + 4 + 2 + 2 * 12 + 4;
+	Buffer file = { 0 };
+	if(!image.failed && image.length > 2) {
+		bufferWrite(&file, image.data, 2);
+		if(!thumbnail.failed && thumbnail.length && 8 + tiffHeader + thumbnail.length <= 65535) {
+			static const uint8_t app1[] = { 0xff, 0xe1 };
+			bufferWrite(&file, (void *)app1, 2);
+			unsigned int segmentLength = (unsigned int)(8 + tiffHeader + thumbnail.length);
+			uint8_t be[2] = { (uint8_t)(segmentLength >> 8), (uint8_t)segmentLength };
+			bufferWrite(&file, be, 2);
+			bufferWrite(&file, "Exif\0\0II*\0", 10);
+			bufferWriteInt(&file, 8, 4);	// IFD0
+			bufferWriteInt(&file, 0, 2);
+			bufferWriteInt(&file, 14, 4);	// IFD1
+			bufferWriteInt(&file, 2, 2);
+			bufferWriteInt(&file, 0x0201, 2);	// JPEGInterchangeFormat, a LONG
+			bufferWriteInt(&file, 4, 2);
+			bufferWriteInt(&file, 1, 4);
+			bufferWriteInt(&file, (unsigned int)tiffHeader, 4);
+			bufferWriteInt(&file, 0x0202, 2);	// JPEGInterchangeFormatLength, a LONG
+			bufferWriteInt(&file, 4, 2);
+			bufferWriteInt(&file, 1, 4);
+			bufferWriteInt(&file, (unsigned int)thumbnail.length, 4);
+			bufferWriteInt(&file, 0, 4);
+			bufferWrite(&file, thumbnail.data, (int)thumbnail.length);
+		}
+		bufferWrite(&file, image.data + 2, (int)(image.length - 2));
+	}
+	free(image.data);
+	free(thumbnail.data);
+	if(file.failed || !file.length) {
+		free(file.data);
+		return NULL;
+	}
+	*length = file.length;
+	return file.data;
+}
+
+static uint8_t *readFile(const char *filename, size_t *length) {
+	FILE *f = fopen(filename, "rb");
+	if(!f) return NULL;
+	uint8_t *data = NULL;
+	long size = -1;
+	if(fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) > 0 && fseek(f, 0, SEEK_SET) == 0) data = malloc(size);
+	if(data && fread(data, 1, size, f) != (size_t)size) {
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+	if(data) *length = size;
+	return data;
+}
+
+// Encodes the image file the way blurhash_encoder does with the loader flags.
+// Returns NULL if it cannot be loaded, or flags asks for a thumbnail and there is none.
+static const char *hashFile(Report *report, const uint8_t *file, size_t length, int flags, int fullWidth, int fullHeight) {
+	int width, height;
+	uint8_t *rgb = loadImageFromMemory(file, length, report->xComponents, report->yComponents, flags, &width, &height, NULL);
+	if(!rgb) return NULL;
+	const char *hash = NULL;
+	if(!(flags & LOAD_THUMBNAIL) || width != fullWidth || height != fullHeight) {
+		hash = blurHashForPixels(report->xComponents, report->yComponents, width, height, rgb, width * 3);
+	}
+	stbi_image_free(rgb);
+	return hash;
+}
+
+/*
+	Runs every mode on one image, whose file is already in memory and decoded
+	at full scale into rgb.
+*/
+static void measureImage(Report *report, uint8_t *rgb, int width, int height, const uint8_t *file, size_t length) {
+	int xComponents = report->xComponents, yComponents = report->yComponents;
+	char reference[BLURHASH_MAX_LENGTH + 1], hash[BLURHASH_MAX_LENGTH + 1];
+
+	double t0 = now();
+	strcpy(reference, blurHashForPixels(xComponents, yComponents, width, height, rgb, width * 3));
+	double referenceSeconds = now() - t0;
+
+	t0 = now();
+	const char *fixedPoint = blurHashForPixelsFixedPoint(xComponents, yComponents, width, height, rgb, width * 3);
+	compareHashes(&report->modes[MODE_FIXED_POINT], reference, fixedPoint, referenceSeconds, now() - t0);
+
+	t0 = now();
+	const char *streaming = blurHashForPixelsStreaming(xComponents, yComponents, width, height, rgb, width * 3);
+	compareHashes(&report->modes[MODE_STREAMING], reference, streaming, referenceSeconds, now() - t0);
+
+	char *hashes[1] = { hash };
+	t0 = now();
+	blurHashForPixelsBatch(1, xComponents, yComponents, width, height, &rgb, width * 3, hashes);
+	compareHashes(&report->modes[MODE_BATCH], reference, hash, referenceSeconds, now() - t0);
+
+	// The loader modes include decompressing the file, since that is where the time goes
+	t0 = now();
+	hashFile(report, file, length, 0, width, height);
+	double loadSeconds = now() - t0;
+
+	t0 = now();
+	const char *downscaled = hashFile(report, file, length, LOAD_DOWNSCALE, width, height);
+	if(downscaled) compareHashes(&report->modes[MODE_DOWNSCALED], reference, downscaled, loadSeconds, now() - t0);
+
+	// Only images that have a usable thumbnail count
+	t0 = now();
+	const char *thumbnail = hashFile(report, file, length, LOAD_THUMBNAIL, width, height);
+	if(thumbnail) compareHashes(&report->modes[MODE_THUMBNAIL], reference, thumbnail, loadSeconds, now() - t0);
+
+	char **grown = realloc(report->hashes, (report->hashCount + 1) * sizeof(char *));
+	if(grown) {
+		report->hashes = grown;
+		if((grown[report->hashCount] = malloc(strlen(reference) + 1))) strcpy(grown[report->hashCount++], reference);
+	}
+
+	int decodeHeight = (int)((long)DECODE_WIDTH * height / width);
+	if(decodeHeight < 1) decodeHeight = 1;
+	size_t bytes = (size_t)DECODE_WIDTH * decodeHeight * 3;
+	uint8_t *referencePixels = malloc(bytes), *pixels = malloc(bytes);
+	if(referencePixels && pixels) {
+		compareDecoders(&report->modes[MODE_DECODE_FIXED_POINT], reference, DECODE_WIDTH, decodeHeight, 1, referencePixels, pixels);
+		// Far past saturation, where the fixed-point decoder caps punch
+		compareDecoders(&report->modes[MODE_DECODE_MAX_PUNCH], reference, DECODE_WIDTH, decodeHeight, INT_MAX, referencePixels, pixels);
+	}
+	free(referencePixels);
+	free(pixels);
+}
+
+// Decodes every reference hash with decodeToArray, decodeToArrays and decodeToSlab
+static void measureBatchDecoders(Report *report) {
+	int count = report->hashCount;
+	size_t bytes = BATCH_DECODE_SIZE * BATCH_DECODE_SIZE * 3;
+	uint8_t *referenceSlab = malloc(count * bytes), *arraysSlab = malloc(count * bytes), *slab = malloc(count * bytes);
+	uint8_t **pixelArrays = malloc(count * sizeof(uint8_t *));
+	if(count && referenceSlab && arraysSlab && slab && pixelArrays) {
+		const char **hashes = (const char **)report->hashes;
+		double t0 = now();
+		for(int round = 0; round < BATCH_DECODE_ROUNDS; round++) {
+			for(int i = 0; i < count; i++) decodeToArray(hashes[i], BATCH_DECODE_SIZE, BATCH_DECODE_SIZE, 1, 3, referenceSlab + i * bytes);
+		}
+		double referenceSeconds = now() - t0;
+
+		for(int i = 0; i < count; i++) pixelArrays[i] = arraysSlab + i * bytes;
+		t0 = now();
+		for(int round = 0; round < BATCH_DECODE_ROUNDS; round++) decodeToArrays(hashes, count, BATCH_DECODE_SIZE, BATCH_DECODE_SIZE, 1, 3, pixelArrays);
+		report->modes[MODE_DECODE_ARRAYS].modeSeconds += now() - t0;
+
+		t0 = now();
+		for(int round = 0; round < BATCH_DECODE_ROUNDS; round++) decodeToSlab(hashes, count, BATCH_DECODE_SIZE, BATCH_DECODE_SIZE, 1, 3, slab);
+		report->modes[MODE_DECODE_SLAB].modeSeconds += now() - t0;
+
+		report->modes[MODE_DECODE_ARRAYS].referenceSeconds += referenceSeconds;
+		report->modes[MODE_DECODE_SLAB].referenceSeconds += referenceSeconds;
+		for(int i = 0; i < count; i++) {
+			comparePixels(&report->modes[MODE_DECODE_ARRAYS], referenceSlab + i * bytes, arraysSlab + i * bytes, bytes);
+			comparePixels(&report->modes[MODE_DECODE_SLAB], referenceSlab + i * bytes, slab + i * bytes, bytes);
+		}
+	}
+	free(referenceSlab);
+	free(arraysSlab);
+	free(slab);
+	free(pixelArrays);
+}
+
+static void printReport(Report *report) {
+	printf("{\"components\": \"%dx%d\", \"modes\": [", report->xComponents, report->yComponents);
+	for(int m = 0; m < MODES; m++) {
+		ModeReport *mode = &report->modes[m];
+		printf("%s\n    {\"mode\": \"%s\", \"images\": %ld, ", m ? "," : "", mode->name, mode->images);
+		if(m >= FIRST_DECODE_MODE) {
+			printf("\"max_pixel_error\": %.0f, ", mode->maxError);
+		} else {
+			printf("\"differing_hashes\": %ld, \"character_mismatch_rate\": %.5f, \"max_coefficient_error\": %.5f, ",
+				mode->differingHashes, mode->characters ? (double)mode->mismatchedCharacters / mode->characters : 0, mode->maxError);
+		}
+		// PSNR only covers the images where the result differs at all
+		if(mode->psnrCount) printf("\"min_psnr_db\": %.2f, \"mean_psnr_db\": %.2f, ", mode->minPsnr, mode->psnrSum / mode->psnrCount);
+		else printf("\"min_psnr_db\": null, \"mean_psnr_db\": null, ");
+		printf("\"speedup\": %.2f}", mode->modeSeconds > 0 ? mode->referenceSeconds / mode->modeSeconds : 0);
+	}
+	printf("\n]}\n");
+}
+
+int main(int argc, const char **argv) {
+	Report report;
+	memset(&report, 0, sizeof(report));
+	report.xComponents = 4;
+	report.yComponents = 3;
+	report.modes[MODE_FIXED_POINT].name = "encode/fixed-point";
+	report.modes[MODE_STREAMING].name = "encode/streaming";
+	report.modes[MODE_BATCH].name = "encode/batch";
+	report.modes[MODE_DOWNSCALED].name = "encode/downscaled";
+	report.modes[MODE_THUMBNAIL].name = "encode/thumbnail";
+	report.modes[MODE_DECODE_FIXED_POINT].name = "decode/fixed-point";
+	report.modes[MODE_DECODE_MAX_PUNCH].name = "decode/fixed-point-max-punch";
+	report.modes[MODE_DECODE_ARRAYS].name = "decode/arrays";
+	report.modes[MODE_DECODE_SLAB].name = "decode/slab";
+
+	int synthetic = 1;
+	int arg = 1;
+	while(arg < argc && strncmp(argv[arg], "--", 2) == 0) {
+		if(strcmp(argv[arg], "--no-synthetic") == 0) synthetic = 0;
+		else if(strcmp(argv[arg], "--components") == 0 && arg + 2 < argc) {
+			report.xComponents = atoi(argv[++arg]);
+			report.yComponents = atoi(argv[++arg]);
+		} else break;
+		arg++;
+	}
+	if(report.xComponents < 1 || report.xComponents > 9 || report.yComponents < 1 || report.yComponents > 9 ||
+		(arg < argc && strncmp(argv[arg], "--", 2) == 0)) {
+		fprintf(stderr, "Usage: %s [--components x_components y_components] [--no-synthetic] imagefile...\n", argv[0]);
+		return 1;
+	}
+
+	for(; arg < argc; arg++) {
+		int width, height;
+		size_t length;
+		uint8_t *file = readFile(argv[arg], &length), *rgb = NULL;
+		if(file) rgb = loadImageFromMemory(file, length, report.xComponents, report.yComponents, 0, &width, &height, NULL);
+		if(rgb) measureImage(&report, rgb, width, height, file, length);
+		else fprintf(stderr, "Failed to load image file \"%s\", skipping it.\n", argv[arg]);
+		stbi_image_free(rgb);
+		free(file);
+	}
+
+	// The generated images go through a JPEG file, so that the loader modes
+	// measure the real reduced-scale decode and thumbnail path
+	for(int kind = 0; synthetic && kind < CORPUS_CLASSES; kind++) {
+		for(size_t s = 0; s < COUNT(syntheticSizes); s++) {
+			int width, height;
+			size_t length;
+			uint8_t *generated = corpusImage(kind, syntheticSizes[s][0], syntheticSizes[s][1], 1), *file = NULL, *rgb = NULL;
+			if(generated) file = syntheticJpeg(report.xComponents, report.yComponents, generated, syntheticSizes[s][0], syntheticSizes[s][1], &length);
+			if(file) rgb = loadImageFromMemory(file, length, report.xComponents, report.yComponents, 0, &width, &height, NULL);
+			if(rgb) measureImage(&report, rgb, width, height, file, length);
+			stbi_image_free(rgb);
+			free(file);
+			free(generated);
+		}
+	}
+
+	measureBatchDecoders(&report);
+	printReport(&report);
+	for(int i = 0; i < report.hashCount; i++) free(report.hashes[i]);
+	free(report.hashes);
+	return 0;
+}
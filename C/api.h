@@ -0,0 +1,18 @@
+#ifndef __BLURHASH_API_H__
+#define __BLURHASH_API_H__
+
+/*
+	Marks the public functions. libblurhash is compiled with -fvisibility=hidden,
+	so only these are exported from libblurhash.so; the helpers shared between
+	its source files stay internal. Define BLURHASH_API before including the
+	headers to override it, for example with __declspec(dllexport).
+*/
+#ifndef BLURHASH_API
+#if defined(__GNUC__) || defined(__clang__)
+#define BLURHASH_API __attribute__((visibility("default")))
+#else
+#define BLURHASH_API
+#endif
+#endif
+
+#endif
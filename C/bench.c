@@ -0,0 +1,419 @@
+#include "encode.h"
+#include "decode.h"
+#include "corpus.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Every case runs at least MIN_ITERATIONS times and then until MIN_SECONDS
+// have passed, up to MAX_ITERATIONS runs. Cases that are slower than that
+// stop after MAX_SECONDS, but always run once.
+#define MIN_ITERATIONS 3
+#define MAX_ITERATIONS 200
+#define MIN_SECONDS 0.5
+#define MAX_SECONDS 10
+
+// --quick skips cases above this many pixels and runs each case once more
+// than MIN_ITERATIONS at most.
+#define QUICK_MAX_PIXELS (1024 * 1024)
+
+// Most cases read from a --baseline file
+#define MAX_BASELINE_CASES 256
+
+typedef const char *(*EncodeFunction)(int xComponents, int yComponents, int width, int height, uint8_t *rgb, size_t bytesPerRow);
+typedef int (*DecodeFunction)(const char *blurhash, int width, int height, int punch, int nChannels, uint8_t *pixelArray);
+
+static const char *blurHashForPixelsStreaming(int xComponents, int yComponents, int width, int height, uint8_t *rgb, size_t bytesPerRow);
+
+static const struct {
+	const char *name;
+	EncodeFunction function;
+} encoders[] = {
+	{ "reference", blurHashForPixels },
+	{ "fixed-point", blurHashForPixelsFixedPoint },
+	{ "streaming", blurHashForPixelsStreaming },
+};
+
+static const struct {
+	const char *name;
+	DecodeFunction function;
+} decoders[] = {
+	{ "reference", decodeToArray },
+	{ "fixed-point", decodeToArrayFixedPoint },
+};
+
+static const int encodeSizes[][2] = { { 64, 64 }, { 256, 256 }, { 1024, 1024 }, { 3840, 2160 }, { 7680, 4320 } };
+static const int encodeComponents[][2] = { { 1, 1 }, { 4, 3 }, { 9, 9 } };
+static const int decodeSizes[][2] = { { 32, 32 }, { 128, 128 }, { 512, 512 }, { 2048, 2048 } };
+static const int decodeComponents[][2] = { { 4, 3 }, { 9, 9 } };
+static const int decodeChannels[] = { 3, 4 };
+
+#define COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+// Hardware counters read with --counters, in this order
+enum { COUNTER_CYCLES, COUNTER_INSTRUCTIONS, COUNTER_L1D_MISSES, COUNTER_LLC_MISSES, COUNTER_BRANCH_MISSES, COUNTERS };
+
+typedef struct {
+	int fds[COUNTERS];
+	// The group leader, and the position of each counter in a group read
+	int leader;
+	int slots[COUNTERS];
+	int opened;
+	uint64_t totals[COUNTERS];
+	// Summed over the runs; running is below enabled when the group was multiplexed
+	uint64_t timeEnabled, timeRunning;
+	int runs;
+} Counters;
+
+// Results of an earlier run, read with --baseline, to compare builds
+typedef struct {
+	struct {
+		char key[96];
+		double nsPerPixel;
+	} cases[MAX_BASELINE_CASES];
+	int count;
+	int matched;
+	double logSpeedups;
+} Baseline;
+
+typedef struct {
+	int quick;
+	const char *filter;
+	int first;
+	Counters *counters;
+	Baseline *baseline;
+} BenchOptions;
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compareDoubles(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const double *sorted, int count, int p) {
+	int rank = (p * count + 99) / 100;
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+/*
+	Counters are opened once for the whole process and enabled only around each
+	measured run. They form one group, so the kernel schedules them together and
+	every ratio between them comes from the same instructions. A counter the
+	kernel or CPU does not support, or that does not fit in the group, stays at
+	-1 and is left out of the output.
+*/
+static Counters *openCounters(void) {
+	Counters *counters = calloc(1, sizeof(Counters));
+	if(!counters) return NULL;
+	counters->leader = -1;
+
+#ifdef __linux__
+	static const struct {
+		uint32_t type;
+		uint64_t config;
+	} events[COUNTERS] = {
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+		{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+		{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	};
+
+	for(int i = 0; i < COUNTERS; i++) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = events[i].type;
+		attr.config = events[i].config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		counters->fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, counters->leader, 0);
+		if(counters->fds[i] < 0) continue;
+		if(counters->leader < 0) counters->leader = counters->fds[i];
+		counters->slots[i] = counters->opened++;
+	}
+#else
+	for(int i = 0; i < COUNTERS; i++) counters->fds[i] = -1;
+#endif
+
+	if(!counters->opened) {
+		fprintf(stderr, "Hardware counters are not available, check perf_event_paranoid.\n");
+		free(counters);
+		return NULL;
+	}
+	return counters;
+}
+
+static void startCounters(Counters *counters) {
+#ifdef __linux__
+	if(!counters) return;
+	ioctl(counters->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(counters->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+static void stopCounters(Counters *counters) {
+#ifdef __linux__
+	if(!counters) return;
+	ioctl(counters->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+	// nr, time_enabled, time_running, then one value per counter
+	uint64_t group[3 + COUNTERS];
+	ssize_t size = (ssize_t)((3 + counters->opened) * sizeof(uint64_t));
+	if(read(counters->leader, group, size) != size) return;
+	uint64_t enabled = group[1], running = group[2];
+	counters->timeEnabled += enabled;
+	counters->timeRunning += running;
+	// Extrapolate a multiplexed run to the whole time it was enabled
+	if(running) {
+		double scale = (double)enabled / running;
+		for(int i = 0; i < COUNTERS; i++) {
+			if(counters->fds[i] >= 0) counters->totals[i] += (uint64_t)(group[3 + counters->slots[i]] * scale);
+		}
+	}
+	counters->runs++;
+#endif
+}
+
+static void printCounters(Counters *counters, double pixels) {
+	static const char *names[COUNTERS] = {
+		"cycles_per_pixel", "instructions_per_pixel", "l1d_misses_per_pixel", "llc_misses_per_pixel", "branch_misses_per_pixel"
+	};
+	double perPixel = 1 / (pixels * (counters->runs ? counters->runs : 1));
+
+	printf(", \"counters\": {");
+	const char *separator = "";
+	if(counters->fds[COUNTER_CYCLES] >= 0 && counters->fds[COUNTER_INSTRUCTIONS] >= 0 && counters->totals[COUNTER_CYCLES]) {
+		printf("\"ipc\": %.3f", (double)counters->totals[COUNTER_INSTRUCTIONS] / counters->totals[COUNTER_CYCLES]);
+		separator = ", ";
+	}
+	for(int i = 0; i < COUNTERS; i++) {
+		if(counters->fds[i] < 0) continue;
+		printf("%s\"%s\": %.4f", separator, names[i], counters->totals[i] * perPixel);
+		separator = ", ";
+	}
+	if(counters->timeEnabled)
+		printf("%s\"running\": %.3f", separator, (double)counters->timeRunning / counters->timeEnabled);
+	printf("}");
+
+	memset(counters->totals, 0, sizeof(counters->totals));
+	counters->timeEnabled = counters->timeRunning = 0;
+	counters->runs = 0;
+}
+
+static void caseKey(char *key, size_t size, const char *benchmark, int width, int height, int xComponents, int yComponents, int channels) {
+	snprintf(key, size, "%s %dx%d %dx%d %d", benchmark, width, height, xComponents, yComponents, channels);
+}
+
+/*
+	Reads the cases of an earlier run of this program. Only the fields needed
+	to match a case and its ns_per_pixel are read, one case per line, as
+	printResult() writes them.
+*/
+static Baseline *loadBaseline(const char *filename) {
+	FILE *f = fopen(filename, "r");
+	if(!f) return NULL;
+	Baseline *baseline = calloc(1, sizeof(Baseline));
+	if(!baseline) {
+		fclose(f);
+		return NULL;
+	}
+
+	char line[2048];
+	while(baseline->count < MAX_BASELINE_CASES && fgets(line, sizeof(line), f)) {
+		char benchmark[64];
+		int width, height, xComponents, yComponents, channels = 0;
+		double nsPerPixel;
+		const char *field = strstr(line, "\"benchmark\": ");
+		if(!field || sscanf(field, "\"benchmark\": \"%63[^\"]\", \"width\": %d, \"height\": %d, \"components\": \"%dx%d\"",
+			benchmark, &width, &height, &xComponents, &yComponents) != 5) continue;
+		if((field = strstr(line, "\"channels\": "))) sscanf(field, "\"channels\": %d", &channels);
+		if(!(field = strstr(line, "\"ns_per_pixel\": ")) || sscanf(field, "\"ns_per_pixel\": %lf", &nsPerPixel) != 1) continue;
+
+		caseKey(baseline->cases[baseline->count].key, sizeof(baseline->cases[0].key),
+			benchmark, width, height, xComponents, yComponents, channels);
+		baseline->cases[baseline->count++].nsPerPixel = nsPerPixel;
+	}
+	fclose(f);
+	return baseline;
+}
+
+static void printBaseline(Baseline *baseline, const char *key, double nsPerPixel) {
+	for(int i = 0; i < baseline->count; i++) {
+		if(strcmp(baseline->cases[i].key, key) != 0) continue;
+		double speedup = baseline->cases[i].nsPerPixel / nsPerPixel;
+		printf(", \"baseline_ns_per_pixel\": %.4f, \"speedup\": %.3f", baseline->cases[i].nsPerPixel, speedup);
+		baseline->logSpeedups += log(speedup);
+		baseline->matched++;
+		return;
+	}
+}
+
+static void printResult(BenchOptions *options, const char *kind, const char *name, int width, int height,
+	int xComponents, int yComponents, int channels, double *samples, int count) {
+	qsort(samples, count, sizeof(double), compareDoubles);
+	double median = percentile(samples, count, 50);
+	double pixels = (double)width * height;
+
+	printf("%s\n    {\"benchmark\": \"%s/%s\", \"width\": %d, \"height\": %d, \"components\": \"%dx%d\", ",
+		options->first ? "" : ",", kind, name, width, height, xComponents, yComponents);
+	if(channels) printf("\"channels\": %d, ", channels);
+	printf("\"iterations\": %d, \"ns_per_pixel\": %.4f, \"mpix_per_s\": %.3f, "
+		"\"min_ns\": %.0f, \"p50_ns\": %.0f, \"p90_ns\": %.0f, \"p99_ns\": %.0f, \"max_ns\": %.0f",
+		count, median / pixels, pixels / median * 1e3,
+		samples[0], median, percentile(samples, count, 90), percentile(samples, count, 99), samples[count - 1]);
+	if(options->counters) printCounters(options->counters, pixels);
+	if(options->baseline) {
+		char key[96], benchmark[64];
+		snprintf(benchmark, sizeof(benchmark), "%s/%s", kind, name);
+		caseKey(key, sizeof(key), benchmark, width, height, xComponents, yComponents, channels);
+		printBaseline(options->baseline, key, median / pixels);
+	}
+	printf("}");
+	fflush(stdout);
+	options->first = 0;
+}
+
+static int selected(BenchOptions *options, const char *kind, const char *name, int width, int height) {
+	if(options->quick && (long)width * height > QUICK_MAX_PIXELS) return 0;
+	if(!options->filter) return 1;
+	char full[64];
+	snprintf(full, sizeof(full), "%s/%s", kind, name);
+	return strstr(full, options->filter) != NULL;
+}
+
+static int keepRunning(BenchOptions *options, int count, double start) {
+	double elapsed = now() - start;
+	if(count == 0) return 1;
+	if(count >= (options->quick ? MIN_ITERATIONS + 1 : MAX_ITERATIONS) || elapsed >= MAX_SECONDS) return 0;
+	return count < MIN_ITERATIONS || elapsed < MIN_SECONDS;
+}
+
+static void benchEncoders(BenchOptions *options) {
+	for(size_t s = 0; s < COUNT(encodeSizes); s++) {
+		int width = encodeSizes[s][0], height = encodeSizes[s][1];
+		uint8_t *rgb = NULL;
+
+		for(size_t e = 0; e < COUNT(encoders); e++) {
+			if(!selected(options, "encode", encoders[e].name, width, height)) continue;
+			if(!rgb) rgb = corpusImage(CORPUS_PHOTO, width, height, 1);
+			if(!rgb) {
+				fprintf(stderr, "Out of memory for a %dx%d image.\n", width, height);
+				return;
+			}
+
+			for(size_t c = 0; c < COUNT(encodeComponents); c++) {
+				int xComponents = encodeComponents[c][0], yComponents = encodeComponents[c][1];
+				double samples[MAX_ITERATIONS];
+				int count = 0;
+				double start = now();
+				while(keepRunning(options, count, start)) {
+					startCounters(options->counters);
+					double t0 = now();
+					encoders[e].function(xComponents, yComponents, width, height, rgb, width * 3);
+					samples[count++] = (now() - t0) * 1e9;
+					stopCounters(options->counters);
+				}
+				printResult(options, "encode", encoders[e].name, width, height, xComponents, yComponents, 0, samples, count);
+			}
+		}
+		free(rgb);
+	}
+}
+
+static void benchDecoders(BenchOptions *options) {
+	// The hashes come from the same kind of synthetic image as the encoder cases
+	char hashes[COUNT(decodeComponents)][BLURHASH_MAX_LENGTH + 1];
+	uint8_t *rgb = corpusImage(CORPUS_PHOTO, 256, 256, 1);
+	if(!rgb) return;
+	for(size_t c = 0; c < COUNT(decodeComponents); c++) {
+		strcpy(hashes[c], blurHashForPixels(decodeComponents[c][0], decodeComponents[c][1], 256, 256, rgb, 256 * 3));
+	}
+	free(rgb);
+
+	for(size_t s = 0; s < COUNT(decodeSizes); s++) {
+		int width = decodeSizes[s][0], height = decodeSizes[s][1];
+		uint8_t *pixels = malloc((size_t)width * height * 4);
+		if(!pixels) return;
+
+		for(size_t d = 0; d < COUNT(decoders); d++) {
+			if(!selected(options, "decode", decoders[d].name, width, height)) continue;
+
+			for(size_t n = 0; n < COUNT(decodeChannels); n++) {
+				for(size_t c = 0; c < COUNT(decodeComponents); c++) {
+					double samples[MAX_ITERATIONS];
+					int count = 0;
+					double start = now();
+					while(keepRunning(options, count, start)) {
+						startCounters(options->counters);
+						double t0 = now();
+						decoders[d].function(hashes[c], width, height, 1, decodeChannels[n], pixels);
+						samples[count++] = (now() - t0) * 1e9;
+						stopCounters(options->counters);
+					}
+					printResult(options, "decode", decoders[d].name, width, height,
+						decodeComponents[c][0], decodeComponents[c][1], decodeChannels[n], samples, count);
+				}
+			}
+		}
+		free(pixels);
+	}
+}
+
+static const char *blurHashForPixelsStreaming(int xComponents, int yComponents, int width, int height, uint8_t *rgb, size_t bytesPerRow) {
+	BlurHashEncoder *encoder = blurHashEncoderBegin(xComponents, yComponents, width, height);
+	if(!encoder) return NULL;
+	blurHashEncoderPushRows(encoder, rgb, height, bytesPerRow);
+	return blurHashEncoderFinish(encoder);
+}
+
+int main(int argc, const char **argv) {
+	BenchOptions options = { 0, NULL, 1, NULL, NULL };
+
+	for(int arg = 1; arg < argc; arg++) {
+		if(strcmp(argv[arg], "--quick") == 0) options.quick = 1;
+		else if(strcmp(argv[arg], "--filter") == 0 && arg + 1 < argc) options.filter = argv[++arg];
+		else if(strcmp(argv[arg], "--counters") == 0) options.counters = openCounters();
+		else if(strcmp(argv[arg], "--baseline") == 0 && arg + 1 < argc) {
+			options.baseline = loadBaseline(argv[++arg]);
+			if(!options.baseline) {
+				fprintf(stderr, "Failed to read baseline file %s\n", argv[arg]);
+				return 1;
+			}
+		}
+		else {
+			fprintf(stderr, "Usage: %s [--quick] [--counters] [--filter encode/reference] [--baseline earlier_output.json]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	printf("{\"benchmarks\": [");
+	benchEncoders(&options);
+	benchDecoders(&options);
+	printf("\n]");
+	// Geometric mean, so that a 2x gain and a 2x loss cancel out
+	if(options.baseline && options.baseline->matched) {
+		printf(", \"baseline_cases\": %d, \"speedup_geomean\": %.3f",
+			options.baseline->matched, exp(options.baseline->logSpeedups / options.baseline->matched));
+	}
+	printf("}\n");
+
+	return 0;
+}
@@ -0,0 +1,13 @@
+#ifndef __BLURHASH_H__
+#define __BLURHASH_H__
+
+/*
+	The public interface of libblurhash in one include: the encoder, the decoder
+	and the metrics export, which only counts anything when the library is built
+	with METRICS=1.
+*/
+#include "encode.h"
+#include "decode.h"
+#include "metrics.h"
+
+#endif
@@ -23,4 +23,42 @@ static inline float signPow(float value, float exp) {
 	return copysignf(powf(fabsf(value), exp), value);
 }
 
+/*
+	Trig-free basis generation. A CosineWalk yields cos(pi * k * x / n) for
+	x = 0, 1, 2, ... by rotating a unit vector by a fixed angle in double
+	precision; each step adds at most about 2^-52 of error, so after 2^20
+	steps the drift stays below 10^-9, well under the 6 * 10^-8 spacing of
+	floats near 1. chebyshevBasis() then expands one cos(t) into cos(i * t)
+	for i < count with cos(i t) = 2 cos(t) cos((i - 1) t) - cos((i - 2) t),
+	which amplifies an error in cos(t) at most i^2 times (64 times for the
+	largest BlurHash component), so the combined error stays below 10^-7.
+*/
+typedef struct {
+	double c, s;
+	double stepC, stepS;
+} CosineWalk;
+
+static inline CosineWalk cosineWalk(int k, int n) {
+	CosineWalk walk = { 1, 0, cos(M_PI * k / n), sin(M_PI * k / n) };
+	return walk;
+}
+
+static inline double cosineWalkNext(CosineWalk *walk) {
+	double value = walk->c;
+	walk->c = value * walk->stepC - walk->s * walk->stepS;
+	walk->s = walk->s * walk->stepC + value * walk->stepS;
+	return value;
+}
+
+static inline void chebyshevBasis(double cosine, int count, float *basis) {
+	double previous = 1, current = cosine;
+	basis[0] = 1;
+	for(int i = 1; i < count; i++) {
+		basis[i] = current;
+		double next = 2 * cosine * current - previous;
+		previous = current;
+		current = next;
+	}
+}
+
 #endif
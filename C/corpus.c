@@ -0,0 +1,161 @@
+#include "corpus.h"
+
+#include <string.h>
+
+// Number of rectangles in a CORPUS_EDGES image
+#define EDGE_RECTANGLES 12
+
+static const char *classNames[CORPUS_CLASSES] = { "flat", "gradient", "noise", "photo", "edges" };
+
+static uint32_t nextRandom(uint32_t *state);
+static uint32_t hashLattice(uint32_t seed, int x, int y, int octave, int channel);
+static uint8_t clampToByte(int value);
+
+const char *corpusClassName(CorpusClass kind) {
+	if(kind < 0 || kind >= CORPUS_CLASSES) return NULL;
+	return classNames[kind];
+}
+
+int corpusClassFromName(const char *name) {
+	for(int i = 0; i < CORPUS_CLASSES; i++) {
+		if(strcmp(name, classNames[i]) == 0) return i;
+	}
+	return -1;
+}
+
+uint8_t *corpusImage(CorpusClass kind, int width, int height, uint32_t seed) {
+	if(kind < 0 || kind >= CORPUS_CLASSES || width < 1 || height < 1) return NULL;
+
+	uint8_t *rgb = malloc((size_t)width * height * 3);
+	if(!rgb) return NULL;
+
+	// Mix the class into the seed so every class gets its own sequence
+	uint32_t state = seed * 2654435761u + kind * 40503u + 1;
+	if(state == 0) state = 1;
+	for(int i = 0; i < 4; i++) nextRandom(&state);
+
+	if(kind == CORPUS_FLAT) {
+		uint32_t colour = nextRandom(&state);
+		for(size_t i = 0; i < (size_t)width * height; i++) {
+			rgb[i * 3 + 0] = colour;
+			rgb[i * 3 + 1] = colour >> 8;
+			rgb[i * 3 + 2] = colour >> 16;
+		}
+	} else if(kind == CORPUS_GRADIENT) {
+		uint32_t from = nextRandom(&state), to = nextRandom(&state);
+		// Direction in 1/256ths, from -256 to 256 along each axis
+		int64_t dx = (int)(nextRandom(&state) % 513) - 256, dy = (int)(nextRandom(&state) % 513) - 256;
+		if(dx == 0 && dy == 0) dx = 256;
+		int64_t corners[4] = { 0, dx * (width - 1), dy * (height - 1), dx * (width - 1) + dy * (height - 1) };
+		int64_t lowest = corners[0], highest = corners[0];
+		for(int i = 1; i < 4; i++) {
+			if(corners[i] < lowest) lowest = corners[i];
+			if(corners[i] > highest) highest = corners[i];
+		}
+		int64_t range = highest > lowest ? highest - lowest : 1;
+
+		for(int y = 0; y < height; y++) {
+			for(int x = 0; x < width; x++) {
+				int64_t t = dx * x + dy * y - lowest;
+				uint8_t *pixel = rgb + ((size_t)y * width + x) * 3;
+				for(int c = 0; c < 3; c++) {
+					int64_t a = (from >> (8 * c)) & 255, b = (to >> (8 * c)) & 255;
+					pixel[c] = a + ((b - a) * t + range / 2) / range;
+				}
+			}
+		}
+	} else if(kind == CORPUS_NOISE) {
+		for(size_t i = 0; i < (size_t)width * height; i++) {
+			uint32_t value = nextRandom(&state);
+			rgb[i * 3 + 0] = value;
+			rgb[i * 3 + 1] = value >> 8;
+			rgb[i * 3 + 2] = value >> 16;
+		}
+	} else if(kind == CORPUS_PHOTO) {
+		// Octave 0 has the largest power-of-two lattice cells that fit the image.
+		// Each octave halves the cell size and the amplitude, so the
+		// amplitude falls off as 1 / frequency. Colour channels share the
+		// luminance octaves and add weaker chroma octaves of their own.
+		int size = width > height ? width : height;
+		int cellShift = 0;
+		while(2 << cellShift <= size) cellShift++;
+		int octaves = cellShift + 1 < 9 ? cellShift + 1 : 9;
+		uint32_t imageSeed = nextRandom(&state);
+
+		// One row of sums at a time, so each lattice value is hashed once per
+		// cell and row instead of once per pixel
+		int (*sums)[4] = malloc(sizeof(int) * 4 * width);
+		if(!sums) {
+			free(rgb);
+			return NULL;
+		}
+
+		for(int y = 0; y < height; y++) {
+			memset(sums, 0, sizeof(int) * 4 * width);
+			for(int o = 0; o < octaves; o++) {
+				int shift = cellShift - o, cellSize = 1 << shift, amplitude = 256 >> o;
+				int cy = y / cellSize, fy = y % cellSize;
+				for(int cx = 0; cx * cellSize < width; cx++) {
+					for(int channel = 0; channel < 4; channel++) {
+						uint32_t v00 = hashLattice(imageSeed, cx, cy, o, channel) & 255;
+						uint32_t v10 = hashLattice(imageSeed, cx + 1, cy, o, channel) & 255;
+						uint32_t v01 = hashLattice(imageSeed, cx, cy + 1, o, channel) & 255;
+						uint32_t v11 = hashLattice(imageSeed, cx + 1, cy + 1, o, channel) & 255;
+						// Interpolate down the cell first, then along the row
+						uint64_t left = (uint64_t)v00 * (cellSize - fy) + (uint64_t)v01 * fy;
+						uint64_t right = (uint64_t)v10 * (cellSize - fy) + (uint64_t)v11 * fy;
+						for(int fx = 0; fx < cellSize && cx * cellSize + fx < width; fx++) {
+							int value = (int)((left * (cellSize - fx) + right * fx) >> (2 * shift)) - 128;
+							sums[cx * cellSize + fx][channel] += value * amplitude / 256;
+						}
+					}
+				}
+			}
+			for(int x = 0; x < width; x++) {
+				uint8_t *pixel = rgb + ((size_t)y * width + x) * 3;
+				for(int c = 0; c < 3; c++) pixel[c] = clampToByte(128 + (sums[x][0] * 3 + sums[x][c + 1]) / 2);
+			}
+		}
+		free(sums);
+	} else if(kind == CORPUS_EDGES) {
+		uint32_t background = nextRandom(&state) & 1 ? 0xffffff : 0;
+		for(size_t i = 0; i < (size_t)width * height; i++) {
+			rgb[i * 3 + 0] = rgb[i * 3 + 1] = rgb[i * 3 + 2] = background;
+		}
+		for(int r = 0; r < EDGE_RECTANGLES; r++) {
+			int left = nextRandom(&state) % width, top = nextRandom(&state) % height;
+			int right = left + 1 + nextRandom(&state) % (width - left), bottom = top + 1 + nextRandom(&state) % (height - top);
+			// Saturated colours: every channel is either 0 or 255
+			uint32_t bits = nextRandom(&state);
+			uint8_t colour[3] = { bits & 1 ? 255 : 0, bits & 2 ? 255 : 0, bits & 4 ? 255 : 0 };
+			for(int y = top; y < bottom; y++) {
+				for(int x = left; x < right; x++) memcpy(rgb + ((size_t)y * width + x) * 3, colour, 3);
+			}
+		}
+	}
+
+	return rgb;
+}
+
+// xorshift32
+static uint32_t nextRandom(uint32_t *state) {
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+static uint32_t hashLattice(uint32_t seed, int x, int y, int octave, int channel) {
+	uint32_t h = seed ^ ((uint32_t)x * 0x8da6b343u) ^ ((uint32_t)y * 0xd8163841u) ^ ((uint32_t)(octave * 4 + channel) * 0xcb1ab31fu);
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	return h;
+}
+
+static uint8_t clampToByte(int value) {
+	return value < 0 ? 0 : value > 255 ? 255 : value;
+}
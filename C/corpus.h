@@ -0,0 +1,41 @@
+#ifndef __BLURHASH_CORPUS_H__
+#define __BLURHASH_CORPUS_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+	Deterministic synthetic images for benchmarks and accuracy checks. The
+	generator only uses integer arithmetic, so the same class, size and seed
+	give the same pixels on every platform.
+*/
+typedef enum {
+	CORPUS_FLAT,		// One random colour
+	CORPUS_GRADIENT,	// Linear blend between two random colours in a random direction
+	CORPUS_NOISE,		// Independent uniform noise in every channel
+	CORPUS_PHOTO,		// Fractal value noise with a 1/f amplitude spectrum, like natural photos
+	CORPUS_EDGES,		// Overlapping high-contrast rectangles with hard edges
+	CORPUS_CLASSES
+} CorpusClass;
+
+/*
+	corpusClassName : Returns the lowercase name of an image class, or NULL if kind is out of range.
+*/
+const char *corpusClassName(CorpusClass kind);
+
+/*
+	corpusClassFromName : Returns the image class with the given name, or -1 if there is none.
+*/
+int corpusClassFromName(const char *name);
+
+/*
+	corpusImage : Generates a synthetic RGB image.
+	Parameters :
+		kind : The image class.
+		width, height : Size of the image in pixels.
+		seed : Any value; different seeds give different images of the same class.
+	Returns : A pointer to width * height * 3 bytes that the caller must free, or NULL on error.
+*/
+uint8_t *corpusImage(CorpusClass kind, int width, int height, uint32_t seed);
+
+#endif
@@ -0,0 +1,65 @@
+#include "corpus.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_writer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int writePPM(const char *filename, const uint8_t *rgb, int width, int height);
+
+int main(int argc, const char **argv) {
+	uint32_t seed = 1;
+	int arg = 1;
+	while(arg < argc && strncmp(argv[arg], "--", 2) == 0) {
+		if(strcmp(argv[arg], "--seed") == 0 && arg + 1 < argc) seed = strtoul(argv[++arg], NULL, 10);
+		else break;
+		arg++;
+	}
+
+	if(argc - arg != 4) {
+		fprintf(stderr, "Usage: %s [--seed n] class width height output.png|output.ppm\n", argv[0]);
+		fprintf(stderr, "Classes:");
+		for(int i = 0; i < CORPUS_CLASSES; i++) fprintf(stderr, " %s", corpusClassName(i));
+		fprintf(stderr, "\n");
+		return 1;
+	}
+
+	int kind = corpusClassFromName(argv[arg]);
+	int width = atoi(argv[arg + 1]);
+	int height = atoi(argv[arg + 2]);
+	const char *output_file = argv[arg + 3];
+	if(kind < 0) {
+		fprintf(stderr, "Unknown image class \"%s\".\n", argv[arg]);
+		return 1;
+	}
+
+	uint8_t *rgb = corpusImage(kind, width, height, seed);
+	if(!rgb) {
+		fprintf(stderr, "Failed to generate a %dx%d image.\n", width, height);
+		return 1;
+	}
+
+	size_t length = strlen(output_file);
+	int ppm = length > 4 && strcmp(output_file + length - 4, ".ppm") == 0;
+	int written = ppm ? writePPM(output_file, rgb, width, height) == 0 :
+		stbi_write_png(output_file, width, height, 3, rgb, width * 3) != 0;
+	free(rgb);
+
+	if(!written) {
+		fprintf(stderr, "Failed to write image file %s\n", output_file);
+		return 1;
+	}
+	return 0;
+}
+
+// Binary PPM (P6)
+static int writePPM(const char *filename, const uint8_t *rgb, int width, int height) {
+	FILE *f = fopen(filename, "wb");
+	if(!f) return -1;
+	fprintf(f, "P6\n%d %d\n255\n", width, height);
+	size_t bytes = (size_t)width * height * 3;
+	int result = fwrite(rgb, 1, bytes, f) == bytes ? 0 : -1;
+	if(fclose(f) != 0) result = -1;
+	return result;
+}
@@ -0,0 +1,42 @@
+#ifndef __BLURHASH_COUNTERS_H__
+#define __BLURHASH_COUNTERS_H__
+
+#include <stdint.h>
+
+/*
+	The recording side of the metrics in metrics.h, shared by the hooks in
+	trace.h and the registry in metrics.c. Not part of the public interface:
+	nothing here is exported from libblurhash.so.
+*/
+
+typedef enum {
+	BLURHASH_ENCODE,
+	BLURHASH_DECODE,
+	BLURHASH_OPS
+} BlurHashOp;
+
+// Entry point families, shared by the metrics labels and the USDT probes in trace.h
+typedef enum {
+	BLURHASH_REFERENCE,		// blurHashForPixels, decodeToArray
+	BLURHASH_FIXED_POINT,	// blurHashForPixelsFixedPoint, decodeToArrayFixedPoint
+	BLURHASH_FACTORS,		// blurHashFactorsForPixels
+	BLURHASH_MULTI,			// blurHashesForPixels
+	BLURHASH_BATCH,			// blurHashForPixelsBatch, decodeToArrays and the decoders built on it
+	BLURHASH_STREAMING,		// blurHashEncoderBegin to blurHashEncoderFinish
+	BLURHASH_MODES
+} BlurHashMode;
+
+// Result of a call, as recorded by the end hooks
+#define BLURHASH_RESULT_OK 0
+#define BLURHASH_RESULT_ERROR -1
+#define BLURHASH_RESULT_INVALID_HASH -2
+
+static inline const char *blurHashModeName(BlurHashMode mode) {
+	static const char *const names[BLURHASH_MODES] = { "reference", "fixed-point", "factors", "multi", "batch", "streaming" };
+	return names[mode];
+}
+
+uint64_t blurHashMetricsNow(void);
+void blurHashMetricsRecord(BlurHashOp op, BlurHashMode mode, int result, uint64_t pixels, uint64_t ns);
+
+#endif
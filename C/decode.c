@@ -1,5 +1,10 @@
 #include "decode.h"
 #include "common.h"
+#include "fixed.h"
+#include "trace.h"
+
+// Number of hashes evaluated together, one per vector lane, by decodeToArrays
+#define DECODE_LANES 8
 
 static char chars[83] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz#$%*+,-.:;=?@[]^_{|}~";
 
@@ -9,7 +14,7 @@ static inline uint8_t clampToUByte(int * src) {
 	return (*src < 0) ? 0 : 255;
 }
 
-static inline uint8_t *  createByteArray(int size) {
+static inline uint8_t *  createByteArray(size_t size) {
 	return (uint8_t *)malloc(size * sizeof(uint8_t));
 }
 
@@ -59,13 +64,23 @@ void decodeAC(int value, float maximumValue, float * r, float * g, float * b) {
 	*b = signPow(((float)quantB - 9) / 9, 2.0) * maximumValue;
 }
 
-int decodeToArray(const char * blurhash, int width, int height, int punch, int nChannels, uint8_t * pixelArray) {
-	if (! isValidBlurhash(blurhash)) return -1;
-	if (punch < 1) punch = 1;
+// Whether every character of the blurhash is a base 83 digit, which isValidBlurhash does not check
+static bool hasOnlyBase83Digits(const char * blurhash) {
+	int iter = 0, length = strlen(blurhash);
+	for (iter = 0; iter < length; iter ++)
+		if (decodeToInt(blurhash, iter, iter + 1) == -1) return false;
+	return true;
+}
 
+/*
+	decodeColors : Parses the components of a valid blurhash into linear colors,
+	               colors should have room for 9 * 9 entries.
+	Returns : int, -1 if error 0 if successful
+*/
+static int decodeColors(const char * blurhash, int punch, int * numX, int * numY, float colors[][3]) {
 	int sizeFlag = decodeToInt(blurhash, 0, 1);
-	int numY = (int)floorf(sizeFlag / 9) + 1;
-	int numX = (sizeFlag % 9) + 1;
+	*numY = (int)floorf(sizeFlag / 9) + 1;
+	*numX = (sizeFlag % 9) + 1;
 	int iter = 0;
 
 	float r = 0, g = 0, b = 0;
@@ -74,8 +89,7 @@ int decodeToArray(const char * blurhash, int width, int height, int punch, int n
 
 	float maxValue = ((float)(quantizedMaxValue + 1)) / 166;
 
-	int colors_size = numX * numY;
-	float colors[colors_size][3];
+	int colors_size = *numX * *numY;
 
 	for(iter = 0; iter < colors_size; iter ++) {
 		if (iter == 0) {
@@ -96,48 +110,384 @@ int decodeToArray(const char * blurhash, int width, int height, int punch, int n
 		}
 	}
 
+	return 0;
+}
+
+static inline void writePixel(uint8_t * pixel, float r, float g, float b, int nChannels) {
+	int intR = linearTosRGB(r);
+	int intG = linearTosRGB(g);
+	int intB = linearTosRGB(b);
+
+	pixel[0] = clampToUByte(&intR);
+	pixel[1] = clampToUByte(&intG);
+	pixel[2] = clampToUByte(&intB);
+
+	if (nChannels == 4)
+		pixel[3] = 255;   // If nChannels=4, treat each pixel as RGBA instead of RGB
+}
+
+/*
+	decodeMirroredRow : Writes one row of pixels from its colors per x component. Pixel width - x sees
+						the basis values of pixel x times (-1)^i, so the even and odd component sums
+						are computed once per mirrored pair and give both pixels as sum and difference.
+						walk starts the x basis at cos(0) with a step of pi / width.
+*/
+static void decodeMirroredRow(float row[][3], int numX, CosineWalk walk, int width, int nChannels, uint8_t * pixels) {
+	int x = 0, i = 0;
+	for (x = 0; x <= width / 2; x ++) {
+		float basics[9];
+		chebyshevBasis(cosineWalkNext(&walk), numX, basics);
+		float even[3] = { 0, 0, 0 }, odd[3] = { 0, 0, 0 };
+		for (i = 0; i < numX; i += 2) {
+			even[0] += row[i][0] * basics[i];
+			even[1] += row[i][1] * basics[i];
+			even[2] += row[i][2] * basics[i];
+		}
+		for (i = 1; i < numX; i += 2) {
+			odd[0] += row[i][0] * basics[i];
+			odd[1] += row[i][1] * basics[i];
+			odd[2] += row[i][2] * basics[i];
+		}
+
+		writePixel(pixels + nChannels * x, even[0] + odd[0], even[1] + odd[1], even[2] + odd[2], nChannels);
+		if (x != 0 && width - x != x)
+			writePixel(pixels + nChannels * (width - x), even[0] - odd[0], even[1] - odd[1], even[2] - odd[2], nChannels);
+	}
+}
+
+/*
+	decodeMirroredRows : decodeMirroredRow for one row of several hashes, one per lane of row,
+						 writing to offset in each of the first lanes pixelArrays.
+*/
+static void decodeMirroredRows(float row[][3][DECODE_LANES], int numX, CosineWalk walk, int width, int nChannels, uint8_t ** pixelArrays, int lanes, size_t offset) {
+	int x = 0, i = 0, channel = 0, lane = 0;
+	for (x = 0; x <= width / 2; x ++) {
+		float basics[9];
+		chebyshevBasis(cosineWalkNext(&walk), numX, basics);
+		float even[3][DECODE_LANES] = { { 0 } }, odd[3][DECODE_LANES] = { { 0 } };
+		for (i = 0; i < numX; i += 2)
+			for (channel = 0; channel < 3; channel ++)
+				for (lane = 0; lane < DECODE_LANES; lane ++)
+					even[channel][lane] += row[i][channel][lane] * basics[i];
+		for (i = 1; i < numX; i += 2)
+			for (channel = 0; channel < 3; channel ++)
+				for (lane = 0; lane < DECODE_LANES; lane ++)
+					odd[channel][lane] += row[i][channel][lane] * basics[i];
+
+		for (lane = 0; lane < lanes; lane ++) {
+			uint8_t * pixels = pixelArrays[lane] + offset;
+			writePixel(pixels + nChannels * x, even[0][lane] + odd[0][lane], even[1][lane] + odd[1][lane], even[2][lane] + odd[2][lane], nChannels);
+			if (x != 0 && width - x != x)
+				writePixel(pixels + nChannels * (width - x), even[0][lane] - odd[0][lane], even[1][lane] - odd[1][lane], even[2][lane] - odd[2][lane], nChannels);
+		}
+	}
+}
+
+int decodeToArray(const char * blurhash, int width, int height, int punch, int nChannels, uint8_t * pixelArray) {
+	TRACE_DECODE_START(BLURHASH_REFERENCE, blurhash, width, height, 1);
+	if (! isValidBlurhash(blurhash)) {
+		TRACE_DECODE_END(BLURHASH_REFERENCE, BLURHASH_RESULT_INVALID_HASH);
+		return -1;
+	}
+	if (punch < 1) punch = 1;
+
+	int numX = 0, numY = 0;
+	float colors[9 * 9][3];
+	if (decodeColors(blurhash, punch, &numX, &numY, colors) == -1) {
+		TRACE_DECODE_END(BLURHASH_REFERENCE, BLURHASH_RESULT_INVALID_HASH);
+		return -1;
+	}
+
+	// The mirrored loops below always visit row and column 0
+	if (width < 1 || height < 1) {
+		TRACE_DECODE_END(BLURHASH_REFERENCE, BLURHASH_RESULT_OK);
+		return 0;
+	}
+
 	int bytesPerRow = width * nChannels;
-	int x = 0, y = 0, i = 0, j = 0;
-	int intR = 0, intG = 0, intB = 0;
+	int y = 0, i = 0, j = 0;
+	CosineWalk walk = cosineWalk(1, height);
+	CosineWalk rowWalk = cosineWalk(1, width);
+
+	// Rows y and height - y are mirrored the same way: the even and odd y component
+	// sums give the colors per x component of both rows.
+	for (y = 0; y <= height / 2; y ++) {
+		float even[9][3], odd[9][3], row[9][3], cosY[9];
+		chebyshevBasis(cosineWalkNext(&walk), numY, cosY);
 
-	for(y = 0; y < height; y ++) {
-		for(x = 0; x < width; x ++) {
+		for (i = 0; i < numX; i ++) {
+			even[i][0] = even[i][1] = even[i][2] = 0;
+			odd[i][0] = odd[i][1] = odd[i][2] = 0;
+			for (j = 0; j < numY; j ++) {
+				float * sum = j % 2 ? odd[i] : even[i];
+				int idx = i + j * numX;
+				sum[0] += colors[idx][0] * cosY[j];
+				sum[1] += colors[idx][1] * cosY[j];
+				sum[2] += colors[idx][2] * cosY[j];
+			}
+			row[i][0] = even[i][0] + odd[i][0];
+			row[i][1] = even[i][1] + odd[i][1];
+			row[i][2] = even[i][2] + odd[i][2];
+		}
+		decodeMirroredRow(row, numX, rowWalk, width, nChannels, pixelArray + y * bytesPerRow);
 
-			float r = 0, g = 0, b = 0;
+		if (y != 0 && height - y != y) {
+			for (i = 0; i < numX; i ++) {
+				row[i][0] = even[i][0] - odd[i][0];
+				row[i][1] = even[i][1] - odd[i][1];
+				row[i][2] = even[i][2] - odd[i][2];
+			}
+			decodeMirroredRow(row, numX, rowWalk, width, nChannels, pixelArray + (height - y) * bytesPerRow);
+		}
+	}
 
-			for(j = 0; j < numY; j ++) {
-				for(i = 0; i < numX; i ++) {
-					float basics = cos((M_PI * x * i) / width) * cos((M_PI * y * j) / height);
-					int idx = i + j * numX;
-					r += colors[idx][0] * basics;
-					g += colors[idx][1] * basics;
-					b += colors[idx][2] * basics;
-				}
+	TRACE_DECODE_END(BLURHASH_REFERENCE, BLURHASH_RESULT_OK);
+	return 0;
+}
+
+/*
+	decodeFixedColors : Same as decodeColors, with the linear colors in Q16.
+	Returns : int, -1 if error 0 if successful
+*/
+static int decodeFixedColors(const char * blurhash, int punch, int * numX, int * numY, int64_t colors[][3]) {
+	int sizeFlag = decodeToInt(blurhash, 0, 1);
+	*numY = sizeFlag / 9 + 1;
+	*numX = sizeFlag % 9 + 1;
+	int iter = 0, channel = 0;
+
+	int quantizedMaxValue = decodeToInt(blurhash, 1, 2);
+	if (quantizedMaxValue == -1) return -1;
+
+	int value = decodeToInt(blurhash, 2, 6);
+	if (value == -1) return -1;
+	colors[0][0] = fixedSRGBToLinear[(value >> 16) & 255];
+	colors[0][1] = fixedSRGBToLinear[(value >> 8) & 255];
+	colors[0][2] = fixedSRGBToLinear[value & 255];
+
+	// signPow((quant - 9) / 9, 2) * (quantizedMaxValue + 1) / 166 * punch
+	int64_t scale = (int64_t)(quantizedMaxValue + 1) * punch << FIXED_LINEAR_SHIFT;
+	for (iter = 1; iter < *numX * *numY; iter ++) {
+		value = decodeToInt(blurhash, 4 + iter * 2, 6 + iter * 2);
+		if (value == -1) return -1;
+		int quant[3] = { value / (19 * 19), value / 19 % 19, value % 19 };
+		for (channel = 0; channel < 3; channel ++) {
+			int64_t signedSquare = (int64_t)(quant[channel] - 9) * abs(quant[channel] - 9);
+			colors[iter][channel] = fixedDivide(signedSquare * scale, 81 * 166);
+		}
+	}
+
+	return 0;
+}
+
+int decodeToArrayFixedPoint(const char * blurhash, int width, int height, int punch, int nChannels, uint8_t * pixelArray) {
+	TRACE_DECODE_START(BLURHASH_FIXED_POINT, blurhash, width, height, 1);
+	if (! isValidBlurhash(blurhash)) {
+		TRACE_DECODE_END(BLURHASH_FIXED_POINT, BLURHASH_RESULT_INVALID_HASH);
+		return -1;
+	}
+	if (punch < 1) punch = 1;
+	if (punch > FIXED_MAX_PUNCH) punch = FIXED_MAX_PUNCH;
+
+	int numX = 0, numY = 0;
+	int64_t colors[9 * 9][3];
+	if (decodeFixedColors(blurhash, punch, &numX, &numY, colors) == -1) {
+		TRACE_DECODE_END(BLURHASH_FIXED_POINT, BLURHASH_RESULT_INVALID_HASH);
+		return -1;
+	}
+
+	int32_t * cosX = (int32_t *)malloc(sizeof(int32_t) * width * numX);
+	if (!cosX) {
+		TRACE_DECODE_END(BLURHASH_FIXED_POINT, BLURHASH_RESULT_ERROR);
+		return -1;
+	}
+
+	int bytesPerRow = width * nChannels;
+	int x = 0, y = 0, i = 0, j = 0;
+	for (x = 0; x < width; x ++)
+		for (i = 0; i < numX; i ++)
+			cosX[x * numX + i] = fixedBasis(i, x, width);
+
+	for (y = 0; y < height; y ++) {
+		// Collapse the y basis into one Q16 color per x component for this row
+		int64_t row[9][3];
+		for (i = 0; i < numX; i ++) {
+			int64_t r = 0, g = 0, b = 0;
+			for (j = 0; j < numY; j ++) {
+				int64_t basics = fixedBasis(j, y, height);
+				int idx = i + j * numX;
+				r += colors[idx][0] * basics;
+				g += colors[idx][1] * basics;
+				b += colors[idx][2] * basics;
 			}
+			row[i][0] = fixedDivide(r, 1 << FIXED_BASIS_SHIFT);
+			row[i][1] = fixedDivide(g, 1 << FIXED_BASIS_SHIFT);
+			row[i][2] = fixedDivide(b, 1 << FIXED_BASIS_SHIFT);
+		}
 
-			intR = linearTosRGB(r);
-			intG = linearTosRGB(g);
-			intB = linearTosRGB(b);
+		for (x = 0; x < width; x ++) {
+			const int32_t * basics = cosX + x * numX;
+			int64_t r = 0, g = 0, b = 0;
+			for (i = 0; i < numX; i ++) {
+				r += row[i][0] * basics[i];
+				g += row[i][1] * basics[i];
+				b += row[i][2] * basics[i];
+			}
 
-			pixelArray[nChannels * x + 0 + y * bytesPerRow] = clampToUByte(&intR);
-			pixelArray[nChannels * x + 1 + y * bytesPerRow] = clampToUByte(&intG);
-			pixelArray[nChannels * x + 2 + y * bytesPerRow] = clampToUByte(&intB);
+			uint8_t * pixel = pixelArray + nChannels * x + y * bytesPerRow;
+			pixel[0] = fixedLinearTosRGB(r);
+			pixel[1] = fixedLinearTosRGB(g);
+			pixel[2] = fixedLinearTosRGB(b);
 
 			if (nChannels == 4)
-				pixelArray[nChannels * x + 3 + y * bytesPerRow] = 255;   // If nChannels=4, treat each pixel as RGBA instead of RGB
+				pixel[3] = 255;
+		}
+	}
+
+	free(cosX);
+	TRACE_DECODE_END(BLURHASH_FIXED_POINT, BLURHASH_RESULT_OK);
+	return 0;
+}
+
+int decodeToArrays(const char ** blurhashes, int count, int width, int height, int punch, int nChannels, uint8_t ** pixelArrays) {
+	TRACE_DECODE_START(BLURHASH_BATCH, count > 0 ? blurhashes[0] : NULL, width, height, count);
+	if (punch < 1) punch = 1;
+
+	int iter = 0, lane = 0, group = 0;
+	// Every hash is checked before any pixel is written
+	for (iter = 0; iter < count; iter ++)
+		if (! isValidBlurhash(blurhashes[iter]) || ! hasOnlyBase83Digits(blurhashes[iter])) {
+			TRACE_DECODE_END(BLURHASH_BATCH, BLURHASH_RESULT_INVALID_HASH);
+			return -1;
+		}
+
+	// The mirrored loops below always visit row and column 0
+	if (width < 1 || height < 1) {
+		TRACE_DECODE_END(BLURHASH_BATCH, BLURHASH_RESULT_OK);
+		return 0;
+	}
+
+	int y = 0, i = 0, j = 0, channel = 0;
+	int bytesPerRow = width * nChannels;
+
+	for (group = 0; group < count; group += DECODE_LANES) {
+		int lanes = count - group < DECODE_LANES ? count - group : DECODE_LANES;
+		int numX = 1, numY = 1;
+
+		// Structure of arrays: colors[component][channel][lane], zero where a
+		// hash has fewer components than the largest one in the group
+		float colors[9 * 9][3][DECODE_LANES];
+		memset(colors, 0, sizeof(colors));
+
+		for (lane = 0; lane < lanes; lane ++) {
+			int laneX = 0, laneY = 0;
+			float laneColors[9 * 9][3];
+			if (decodeColors(blurhashes[group + lane], punch, &laneX, &laneY, laneColors) == -1) {
+				TRACE_DECODE_END(BLURHASH_BATCH, BLURHASH_RESULT_INVALID_HASH);
+				return -1;
+			}
+			if (laneX > numX) numX = laneX;
+			if (laneY > numY) numY = laneY;
+			for (j = 0; j < laneY; j ++) {
+				for (i = 0; i < laneX; i ++) {
+					colors[i + j * 9][0][lane] = laneColors[i + j * laneX][0];
+					colors[i + j * 9][1][lane] = laneColors[i + j * laneX][1];
+					colors[i + j * 9][2][lane] = laneColors[i + j * laneX][2];
+				}
+			}
+		}
+
+		// The same basis values and mirrored sums as decodeToArray, one hash per lane
+		CosineWalk walk = cosineWalk(1, height);
+		CosineWalk rowWalk = cosineWalk(1, width);
+		for (y = 0; y <= height / 2; y ++) {
+			float even[9][3][DECODE_LANES], odd[9][3][DECODE_LANES], row[9][3][DECODE_LANES], cosY[9];
+			chebyshevBasis(cosineWalkNext(&walk), numY, cosY);
+
+			for (i = 0; i < numX; i ++) {
+				memset(even[i], 0, sizeof(even[i]));
+				memset(odd[i], 0, sizeof(odd[i]));
+				for (j = 0; j < numY; j ++) {
+					float (* sum)[DECODE_LANES] = j % 2 ? odd[i] : even[i];
+					int idx = i + j * 9;
+					for (channel = 0; channel < 3; channel ++)
+						for (lane = 0; lane < DECODE_LANES; lane ++)
+							sum[channel][lane] += colors[idx][channel][lane] * cosY[j];
+				}
+				for (channel = 0; channel < 3; channel ++)
+					for (lane = 0; lane < DECODE_LANES; lane ++)
+						row[i][channel][lane] = even[i][channel][lane] + odd[i][channel][lane];
+			}
+			decodeMirroredRows(row, numX, rowWalk, width, nChannels, pixelArrays + group, lanes, (size_t)y * bytesPerRow);
 
+			if (y != 0 && height - y != y) {
+				for (i = 0; i < numX; i ++)
+					for (channel = 0; channel < 3; channel ++)
+						for (lane = 0; lane < DECODE_LANES; lane ++)
+							row[i][channel][lane] = even[i][channel][lane] - odd[i][channel][lane];
+				decodeMirroredRows(row, numX, rowWalk, width, nChannels, pixelArrays + group, lanes, (size_t)(height - y) * bytesPerRow);
+			}
 		}
 	}
 
+	TRACE_DECODE_END(BLURHASH_BATCH, BLURHASH_RESULT_OK);
+	return 0;
+}
+
+int decodeToSlab(const char ** blurhashes, int count, int width, int height, int punch, int nChannels, uint8_t * slab) {
+	uint8_t ** pixelArrays = (uint8_t **)malloc(sizeof(uint8_t *) * (count > 0 ? count : 1));
+	if (!pixelArrays) return -1;
+
+	int iter = 0;
+	for (iter = 0; iter < count; iter ++)
+		pixelArrays[iter] = slab + (size_t)iter * width * height * nChannels;
+
+	int result = decodeToArrays(blurhashes, count, width, height, punch, nChannels, pixelArrays);
+	free(pixelArrays);
+	return result;
+}
+
+int decodeToAtlas(const char ** blurhashes, int count, int columns, int tileWidth, int tileHeight, int padding, int punch, int nChannels, uint8_t * atlas) {
+	if (count < 1 || columns < 1 || tileWidth < 1 || tileHeight < 1 || padding < 0) return -1;
+	if (nChannels != 3 && nChannels != 4) return -1;
+
+	size_t rows = (count + columns - 1) / columns;
+	size_t atlasWidth = (size_t)columns * tileWidth + (size_t)(columns - 1) * padding;
+	size_t atlasHeight = rows * tileHeight + (rows - 1) * padding;
+	size_t tileBytes = (size_t)tileWidth * nChannels;
+	size_t atlasBytesPerRow = atlasWidth * nChannels;
+
+	uint8_t * tiles = (uint8_t *)malloc((size_t)count * tileBytes * tileHeight);
+	if (!tiles) return -1;
+
+	if (decodeToSlab(blurhashes, count, tileWidth, tileHeight, punch, nChannels, tiles) == -1) {
+		free(tiles);
+		return -1;
+	}
+
+	// Padding and unused tiles are left fully transparent (or black for RGB)
+	memset(atlas, 0, atlasBytesPerRow * atlasHeight);
+
+	int iter = 0, y = 0;
+	for (iter = 0; iter < count; iter ++) {
+		size_t left = (size_t)(iter % columns) * (tileWidth + padding);
+		size_t top = (size_t)(iter / columns) * (tileHeight + padding);
+		for (y = 0; y < tileHeight; y ++)
+			memcpy(atlas + (top + y) * atlasBytesPerRow + left * nChannels,
+				tiles + ((size_t)iter * tileHeight + y) * tileBytes, tileBytes);
+	}
+
+	free(tiles);
 	return 0;
 }
 
 uint8_t * decode(const char * blurhash, int width, int height, int punch, int nChannels) {
-	int bytesPerRow = width * nChannels;
-	uint8_t * pixelArray = createByteArray(bytesPerRow * height);
+	uint8_t * pixelArray = createByteArray((size_t)width * height * nChannels);
+	if (!pixelArray) return NULL;
 
-	if (decodeToArray(blurhash, width, height, punch, nChannels, pixelArray) == -1)
+	if (decodeToArray(blurhash, width, height, punch, nChannels, pixelArray) == -1) {
+		free(pixelArray);
 		return NULL;
+	}
 	return pixelArray;
 }
 
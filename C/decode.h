@@ -8,6 +8,8 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#include "api.h"
+
 /*
 	decode : Returns the pixel array of the result image given the blurhash string,
 	Parameters : 
@@ -18,7 +20,7 @@
 		nChannels : Number of channels in the resulting image array, 3 = RGB, 4 = RGBA
 	Returns : A pointer to memory region where pixels are stored in (H, W, C) format
 */
-uint8_t * decode(const char * blurhash, int width, int height, int punch, int nChannels);
+BLURHASH_API uint8_t * decode(const char * blurhash, int width, int height, int punch, int nChannels);
 
 /*
 	decodeToArray : Decodes the blurhash and copies the pixels to pixelArray,
@@ -33,7 +35,62 @@ uint8_t * decode(const char * blurhash, int width, int height, int punch, int nC
 		pixelArray : Pointer to memory region where pixels needs to be copied.
 	Returns : int, -1 if error 0 if successful
 */
-int decodeToArray(const char * blurhash, int width, int height, int punch, int nChannels, uint8_t * pixelArray);
+BLURHASH_API int decodeToArray(const char * blurhash, int width, int height, int punch, int nChannels, uint8_t * pixelArray);
+
+/*
+	decodeToArrayFixedPoint : Same as decodeToArray, using only integer arithmetic and lookup tables.
+							  The output is bit-exact on every platform, and each channel is within
+							  1 of decodeToArray. punch is capped at 65536, which keeps the integer
+							  sums from overflowing; any pixel it leaves unsaturated has AC terms
+							  that cancel exactly.
+	Returns : int, -1 if error 0 if successful
+*/
+BLURHASH_API int decodeToArrayFixedPoint(const char * blurhash, int width, int height, int punch, int nChannels, uint8_t * pixelArray);
+
+/*
+	decodeToArrays : Decodes several blurhashes to the same output size, evaluating a group
+					 of hashes together with the basis values and mirrored sums of decodeToArray.
+					 The vectorised sums can round differently, so a channel may differ from
+					 decodeToArray by 1.
+					 Each pixelArrays[i] should be of size : width * height * nChannels
+	Parameters :
+		blurhashes : Array of count strings representing the blurhashes to be decoded.
+		count : Number of blurhashes
+		width : Width of the resulting images
+		height : Height of the resulting images
+		punch : The factor to improve the contrast, default = 1
+		nChannels : Number of channels in the resulting image arrays, 3 = RGB, 4 = RGBA
+		pixelArrays : Array of count pointers to memory regions where pixels need to be copied.
+	Returns : int, -1 if any blurhash is invalid (nothing is written), 0 if successful
+*/
+BLURHASH_API int decodeToArrays(const char ** blurhashes, int count, int width, int height, int punch, int nChannels, uint8_t ** pixelArrays);
+
+/*
+	decodeToSlab : Same as decodeToArrays, but writes all the images one after another into
+				   one contiguous slab of size : count * width * height * nChannels
+	Returns : int, -1 if error 0 if successful
+*/
+BLURHASH_API int decodeToSlab(const char ** blurhashes, int count, int width, int height, int punch, int nChannels, uint8_t * slab);
+
+/*
+	decodeToAtlas : Decodes several blurhashes into the tiles of one atlas image, filled left to right
+					and top to bottom. The atlas has
+						columns * tileWidth + (columns - 1) * padding pixels per row, and
+						rows * tileHeight + (rows - 1) * padding rows, where rows = ceil(count / columns);
+					atlas should be of size : atlas width * atlas height * nChannels
+	Parameters :
+		blurhashes : Array of count strings representing the blurhashes to be decoded.
+		count : Number of blurhashes
+		columns : Number of tiles per atlas row
+		tileWidth, tileHeight : Size of each decoded tile
+		padding : Pixels between neighbouring tiles, left transparent (black for nChannels = 3)
+		punch : The factor to improve the contrast, default = 1
+		nChannels : Number of channels in the atlas, 3 = RGB, 4 = RGBA
+		atlas : Pointer to memory region where the atlas pixels need to be written.
+	Returns : int, -1 if error (including count, columns, tileWidth or tileHeight below 1, negative padding
+			  or nChannels other than 3 and 4), 0 if successful
+*/
+BLURHASH_API int decodeToAtlas(const char ** blurhashes, int count, int columns, int tileWidth, int tileHeight, int padding, int punch, int nChannels, uint8_t * atlas);
 
 /*
 	isValidBlurhash : Checks if the Blurhash is valid or not.
@@ -41,7 +98,7 @@ int decodeToArray(const char * blurhash, int width, int height, int punch, int n
 		blurhash : A string representing the blurhash
 	Returns : bool (true if it is a valid blurhash, else false)
 */
-bool isValidBlurhash(const char * blurhash); 
+BLURHASH_API bool isValidBlurhash(const char * blurhash); 
 
 /*
 	freePixelArray : Frees the pixel array
@@ -49,6 +106,6 @@ bool isValidBlurhash(const char * blurhash);
 		pixelArray : Pixel array pointer which will be freed.
 	Returns : void (None)
 */
-void freePixelArray(uint8_t * pixelArray);
+BLURHASH_API void freePixelArray(uint8_t * pixelArray);
 
 #endif
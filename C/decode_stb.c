@@ -1,11 +1,39 @@
 #include "decode.h"
+#include "stats.h"
+
+#include <limits.h>
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_writer.h"
 
+static int decodeAtlas(int argc, char **argv, Stats *stats);
+static uint8_t *createPixels(int64_t width, int64_t height, int nChannels);
+
 int main(int argc, char **argv) {
+	int fixedPoint = 0;
+	Stats statsStorage, *stats = NULL;
+	while(argc >= 2 && (strcmp(argv[1], "--fixed-point") == 0 || strcmp(argv[1], "--stats") == 0)) {
+		if(strcmp(argv[1], "--fixed-point") == 0)
+			fixedPoint = 1;
+		else
+			stats = &statsStorage;
+		argv[1] = argv[0];
+		argv ++;
+		argc --;
+	}
+	statsBegin(stats);
+
+	if(argc >= 2 && strcmp(argv[1], "--atlas") == 0) {
+		if(fixedPoint) {
+			fprintf(stderr, "--fixed-point cannot be combined with --atlas.\n");
+			return 1;
+		}
+		return decodeAtlas(argc, argv, stats);
+	}
+
 	if(argc < 5) {
-		fprintf(stderr, "Usage: %s hash width height output_file [punch]\n", argv[0]);
+		fprintf(stderr, "Usage: %s [--fixed-point] [--stats] hash width height output_file [punch]\n", argv[0]);
+		fprintf(stderr, "       %s [--stats] --atlas tile_width tile_height padding output_png output_json hash...\n", argv[0]);
 		return 1;
 	}
 
@@ -20,7 +48,18 @@ int main(int argc, char **argv) {
 	if(argc == 6)
 		punch = atoi(argv[5]);
 
-	uint8_t * bytes = decode(hash, width, height, punch, nChannels);
+	uint8_t * bytes = createPixels(width, height, nChannels);
+	if (!bytes) {
+		fprintf(stderr, "The width and height must be positive and the image must fit in 2 GB.\n");
+		return 1;
+	}
+	int result = fixedPoint ? decodeToArrayFixedPoint(hash, width, height, punch, nChannels, bytes) :
+		decodeToArray(hash, width, height, punch, nChannels, bytes);
+	if (result == -1) {
+		freePixelArray(bytes);
+		bytes = NULL;
+	}
+	statsStage(stats, "decode");
 
 	if (!bytes) {
 		fprintf(stderr, "%s is not a valid blurhash, decoding failed.\n", hash);
@@ -33,7 +72,119 @@ int main(int argc, char **argv) {
 	}
 
 	freePixelArray(bytes);
+	statsStage(stats, "write");
+
+	if(stats) {
+		stats->bytesRead = strlen(hash);
+		stats->bytesWritten = statsFileSize(output_file);
+		stats->pixels = (uint64_t)width * height;
+	}
+	statsPrint(stats, "blurhash_decoder");
 
 	fprintf(stdout, "Decoded blurhash successfully, wrote PNG file %s\n", output_file);
 	return 0;
 }
+
+/*
+	decodeAtlas : Decodes all the hashes on the command line into one PNG atlas, and writes a JSON
+				  map from each hash to its tile rectangle. With stats, the validation time of each
+				  hash goes into a histogram, and the decode stage is the one decodeToAtlas call.
+*/
+static int decodeAtlas(int argc, char **argv, Stats *stats) {
+	if(argc < 8) {
+		fprintf(stderr, "Usage: %s --atlas tile_width tile_height padding output_png output_json hash...\n", argv[0]);
+		return 1;
+	}
+
+	int tileWidth = atoi(argv[2]);
+	int tileHeight = atoi(argv[3]);
+	int padding = atoi(argv[4]);
+	char * output_file = argv[5];
+	char * json_file = argv[6];
+	const char ** hashes = (const char **)argv + 7;
+	int count = argc - 7;
+
+	const int nChannels = 4;
+
+	if(tileWidth < 1 || tileHeight < 1 || padding < 0) {
+		fprintf(stderr, "Tile sizes must be positive and padding must not be negative.\n");
+		return 1;
+	}
+
+	int iter = 0;
+	for(iter = 0; iter < count; iter ++) {
+		uint64_t start = stats ? statsNow() : 0;
+		if(!isValidBlurhash(hashes[iter])) {
+			fprintf(stderr, "%s is not a valid blurhash, decoding failed.\n", hashes[iter]);
+			return 1;
+		}
+		if(stats) {
+			statsSample(stats, "validate_ns_per_hash", statsNow() - start);
+			stats->bytesRead += strlen(hashes[iter]);
+		}
+	}
+	statsStage(stats, "validate");
+
+	// Roughly square atlas
+	int columns = 1;
+	while(columns * columns < count)
+		columns ++;
+	int rows = (count + columns - 1) / columns;
+	int64_t atlasWidth = (int64_t)columns * tileWidth + (int64_t)(columns - 1) * padding;
+	int64_t atlasHeight = (int64_t)rows * tileHeight + (int64_t)(rows - 1) * padding;
+
+	uint8_t * bytes = createPixels(atlasWidth, atlasHeight, nChannels);
+	if(!bytes) {
+		fprintf(stderr, "The atlas is too large.\n");
+		return 1;
+	}
+	int width = (int)atlasWidth, height = (int)atlasHeight;
+	if(decodeToAtlas(hashes, count, columns, tileWidth, tileHeight, padding, 1, nChannels, bytes) == -1) {
+		fprintf(stderr, "Decoding the atlas failed.\n");
+		freePixelArray(bytes);
+		return 1;
+	}
+	statsStage(stats, "decode");
+
+	if (stbi_write_png(output_file, width, height, nChannels, bytes, nChannels * width) == 0) {
+		fprintf(stderr, "Failed to write PNG file %s\n", output_file);
+		freePixelArray(bytes);
+		return 1;
+	}
+	freePixelArray(bytes);
+
+	FILE * json = fopen(json_file, "w");
+	if(!json) {
+		fprintf(stderr, "Failed to write JSON file %s\n", json_file);
+		return 1;
+	}
+	// Base83 has no characters that need escaping in a JSON string
+	fprintf(json, "{\"width\": %d, \"height\": %d, \"tiles\": [\n", width, height);
+	for(iter = 0; iter < count; iter ++) {
+		fprintf(json, "  {\"hash\": \"%s\", \"x\": %d, \"y\": %d, \"width\": %d, \"height\": %d}%s\n",
+			hashes[iter], (iter % columns) * (tileWidth + padding), (iter / columns) * (tileHeight + padding),
+			tileWidth, tileHeight, iter + 1 < count ? "," : "");
+	}
+	fprintf(json, "]}\n");
+	fclose(json);
+	statsStage(stats, "write");
+
+	if(stats) {
+		stats->bytesWritten = statsFileSize(output_file) + statsFileSize(json_file);
+		stats->pixels = (uint64_t)width * height;
+	}
+	statsPrint(stats, "blurhash_decoder");
+
+	fprintf(stdout, "Decoded %d blurhashes successfully, wrote PNG file %s and JSON file %s\n", count, output_file, json_file);
+	return 0;
+}
+
+/*
+	createPixels : Allocates an image of width * height pixels for stbi_write_png, which keeps its
+				   sizes in int. Returns NULL if a side is not positive, the image does not fit in
+				   INT_MAX bytes, or memory runs out.
+*/
+static uint8_t *createPixels(int64_t width, int64_t height, int nChannels) {
+	if(width < 1 || height < 1 || width > INT_MAX / nChannels / height) return NULL;
+	return (uint8_t *)malloc((size_t)width * height * nChannels);
+}
@@ -1,39 +1,412 @@
 #include "encode.h"
 #include "common.h"
+#include "fixed.h"
+#include "trace.h"
 
 #include <string.h>
 
+static void computeFactors(int xComponents, int yComponents, int width, int height, uint8_t *rgb, size_t bytesPerRow, float *factors);
 static float *multiplyBasisFunction(int xComponent, int yComponent, int width, int height, uint8_t *rgb, size_t bytesPerRow);
+static void quantiseFactors(int xComponents, int yComponents, float *factors, int *quantised);
+static char *encodeFactors(int xComponents, int yComponents, float *factors, char *destination);
+static char *encodeQuantised(int xComponents, int yComponents, const int *quantised, char *destination);
+static void fixedRowSums(const uint8_t *src, int width, int xComponents, const int32_t *xBasis, int64_t rowSums[][3]);
+static void quantiseFixedFactors(int xComponents, int yComponents, int64_t *factors, int *quantised);
 static char *encode_int(int value, int length, char *destination);
 
 static int encodeDC(float r, float g, float b);
 static int encodeAC(float r, float g, float b, float maximumValue);
 
 const char *blurHashForPixels(int xComponents, int yComponents, int width, int height, uint8_t *rgb, size_t bytesPerRow) {
-	static char buffer[2 + 4 + (9 * 9 - 1) * 2 + 1];
+	static char buffer[BLURHASH_MAX_LENGTH + 1];
+
+	TRACE_ENCODE_START(BLURHASH_REFERENCE, width, height, xComponents, yComponents, 1);
+	if(xComponents < 1 || xComponents > 9 || yComponents < 1 || yComponents > 9) {
+		TRACE_ENCODE_END(BLURHASH_REFERENCE, BLURHASH_RESULT_ERROR, NULL);
+		return NULL;
+	}
+
+	float factors[yComponents][xComponents][3];
+	computeFactors(xComponents, yComponents, width, height, rgb, bytesPerRow, factors[0][0]);
+
+	encodeFactors(xComponents, yComponents, factors[0][0], buffer);
+
+	TRACE_ENCODE_END(BLURHASH_REFERENCE, BLURHASH_RESULT_OK, buffer);
+	return buffer;
+}
+
+const char *blurHashForPixelsFixedPoint(int xComponents, int yComponents, int width, int height, uint8_t *rgb, size_t bytesPerRow) {
+	static char buffer[BLURHASH_MAX_LENGTH + 1];
+
+	TRACE_ENCODE_START(BLURHASH_FIXED_POINT, width, height, xComponents, yComponents, 1);
+	// The size limit keeps the 64-bit sums below from overflowing
+	if(xComponents < 1 || xComponents > 9 || yComponents < 1 || yComponents > 9 ||
+			width < 1 || height < 1 || (uint64_t)width * height > UINT32_MAX) {
+		TRACE_ENCODE_END(BLURHASH_FIXED_POINT, BLURHASH_RESULT_ERROR, NULL);
+		return NULL;
+	}
+
+	// Only the left half of the x basis is needed, see fixedRowSums()
+	int32_t *xBasis = malloc(sizeof(int32_t) * (width / 2 + 1) * xComponents);
+	if(!xBasis) {
+		TRACE_ENCODE_END(BLURHASH_FIXED_POINT, BLURHASH_RESULT_ERROR, NULL);
+		return NULL;
+	}
+	for(int x = 0; x <= width / 2; x++) {
+		for(int i = 0; i < xComponents; i++) {
+			xBasis[x * xComponents + i] = fixedBasis(i, x, width);
+		}
+	}
+
+	int64_t sums[yComponents][xComponents][3];
+	memset(sums, 0, sizeof(sums));
+
+	// Rows y and height - y are folded the same way as columns: even
+	// components take the sum of the two rows and odd ones the difference.
+	for(int y = 0; y <= height / 2; y++) {
+		int mirror = height - y;
+		int paired = y != 0 && mirror != y;
+		int64_t top[xComponents][3], bottom[xComponents][3];
+		fixedRowSums(rgb + y * bytesPerRow, width, xComponents, xBasis, top);
+		if(paired) fixedRowSums(rgb + mirror * bytesPerRow, width, xComponents, xBasis, bottom);
+
+		int64_t yBasis[yComponents];
+		for(int j = 0; j < yComponents; j++) yBasis[j] = fixedBasis(j, y, height);
+
+		// Row sums back to Q16, then times the Q15 y basis into Q31
+		for(int i = 0; i < xComponents; i++) {
+			for(int c = 0; c < 3; c++) {
+				int64_t value = fixedDivide(top[i][c], 1 << FIXED_BASIS_SHIFT);
+				int64_t mirrored = paired ? fixedDivide(bottom[i][c], 1 << FIXED_BASIS_SHIFT) : 0;
+				for(int j = 0; j < yComponents; j++) {
+					sums[j][i][c] += yBasis[j] * (j & 1 ? value - mirrored : value + mirrored);
+				}
+			}
+		}
+	}
+
+	free(xBasis);
+
+	int64_t factors[yComponents][xComponents][3];
+	int64_t pixels = (int64_t)width * height;
+	for(int j = 0; j < yComponents; j++) {
+		for(int i = 0; i < xComponents; i++) {
+			int normalisation = (i == 0 && j == 0) ? 1 : 2;
+			factors[j][i][0] = fixedDivide(sums[j][i][0], pixels) * normalisation;
+			factors[j][i][1] = fixedDivide(sums[j][i][1], pixels) * normalisation;
+			factors[j][i][2] = fixedDivide(sums[j][i][2], pixels) * normalisation;
+		}
+	}
+
+	int quantised[xComponents * yComponents + 1];
+	quantiseFixedFactors(xComponents, yComponents, factors[0][0], quantised);
+	encodeQuantised(xComponents, yComponents, quantised, buffer);
+
+	TRACE_ENCODE_END(BLURHASH_FIXED_POINT, BLURHASH_RESULT_OK, buffer);
+	return buffer;
+}
+
+const char *blurHashForFactors(int xComponents, int yComponents, float *factors) {
+	static char buffer[BLURHASH_MAX_LENGTH + 1];
 
 	if(xComponents < 1 || xComponents > 9) return NULL;
 	if(yComponents < 1 || yComponents > 9) return NULL;
 
+	encodeFactors(xComponents, yComponents, factors, buffer);
+
+	return buffer;
+}
+
+int blurHashFactorsForPixels(int xComponents, int yComponents, int width, int height, uint8_t *rgb, size_t bytesPerRow, float *factors, int *quantised) {
+	TRACE_ENCODE_START(BLURHASH_FACTORS, width, height, xComponents, yComponents, 1);
+	if(xComponents < 1 || xComponents > 9 || yComponents < 1 || yComponents > 9) {
+		TRACE_ENCODE_END(BLURHASH_FACTORS, BLURHASH_RESULT_ERROR, NULL);
+		return -1;
+	}
+
+	computeFactors(xComponents, yComponents, width, height, rgb, bytesPerRow, factors);
+	if(quantised) quantiseFactors(xComponents, yComponents, factors, quantised);
+
+	TRACE_ENCODE_END(BLURHASH_FACTORS, BLURHASH_RESULT_OK, NULL);
+	return 0;
+}
+
+int blurHashesForPixels(int count, const int *xComponents, const int *yComponents, int width, int height, uint8_t *rgb, size_t bytesPerRow, char **hashes) {
+	if(count < 1) return 0;
+
+	int maxX = 1, maxY = 1, valid = 1;
+	for(int i = 0; i < count; i++) {
+		if(xComponents[i] < 1 || xComponents[i] > 9) valid = 0;
+		if(yComponents[i] < 1 || yComponents[i] > 9) valid = 0;
+		if(xComponents[i] > maxX) maxX = xComponents[i];
+		if(yComponents[i] > maxY) maxY = yComponents[i];
+	}
+	TRACE_ENCODE_START(BLURHASH_MULTI, width, height, maxX, maxY, count);
+	if(!valid) {
+		TRACE_ENCODE_END(BLURHASH_MULTI, BLURHASH_RESULT_ERROR, NULL);
+		return -1;
+	}
+
+	// Every factor only depends on its own basis function, so the grid for
+	// the largest counts contains the factors of all the smaller ones.
+	float factors[maxY][maxX][3];
+	computeFactors(maxX, maxY, width, height, rgb, bytesPerRow, factors[0][0]);
+
+	for(int i = 0; i < count; i++) {
+		float subFactors[yComponents[i]][xComponents[i]][3];
+		for(int y = 0; y < yComponents[i]; y++) {
+			memcpy(subFactors[y], factors[y], sizeof(subFactors[y]));
+		}
+		encodeFactors(xComponents[i], yComponents[i], subFactors[0][0], hashes[i]);
+	}
+
+	TRACE_ENCODE_END(BLURHASH_MULTI, BLURHASH_RESULT_OK, hashes[0]);
+	return 0;
+}
+
+struct BlurHashEncoder {
+	int xComponents, yComponents;
+	int width, height;
+	int row;
+	float linear[256];
+	float factors[9][9][3];
+	float rowFactors[9][3];
+#ifdef BLURHASH_METRICS
+	TraceScope traceScope;
+#endif
+	float xBasis[]; // width * xComponents
+};
+
+BlurHashEncoder *blurHashEncoderBegin(int xComponents, int yComponents, int width, int height) {
+	TRACE_ENCODE_START(BLURHASH_STREAMING, width, height, xComponents, yComponents, 1);
+	BlurHashEncoder *encoder = NULL;
+	if(xComponents >= 1 && xComponents <= 9 && yComponents >= 1 && yComponents <= 9 && width >= 1 && height >= 1)
+		encoder = malloc(sizeof(BlurHashEncoder) + sizeof(float) * width * xComponents);
+	if(!encoder) {
+		TRACE_ENCODE_END(BLURHASH_STREAMING, BLURHASH_RESULT_ERROR, NULL);
+		return NULL;
+	}
+	TRACE_SAVE(encoder->traceScope);
+
+	encoder->xComponents = xComponents;
+	encoder->yComponents = yComponents;
+	encoder->width = width;
+	encoder->height = height;
+	encoder->row = 0;
+	memset(encoder->factors, 0, sizeof(encoder->factors));
+
+	for(int i = 0; i < 256; i++) encoder->linear[i] = sRGBToLinear(i);
+	for(int x = 0; x < width; x++) {
+		for(int i = 0; i < xComponents; i++) {
+			encoder->xBasis[x * xComponents + i] = cosf(M_PI * i * x / width);
+		}
+	}
+
+	return encoder;
+}
+
+int blurHashEncoderPushRows(BlurHashEncoder *encoder, const uint8_t *rgb, int rows, size_t bytesPerRow) {
+	if(encoder->row + rows > encoder->height) return -1;
+
+	int xComponents = encoder->xComponents;
+	for(int r = 0; r < rows; r++, encoder->row++) {
+		const uint8_t *src = rgb + r * bytesPerRow;
+		memset(encoder->rowFactors, 0, sizeof(encoder->rowFactors));
+
+		for(int x = 0; x < encoder->width; x++) {
+			float red = encoder->linear[src[3 * x + 0]];
+			float green = encoder->linear[src[3 * x + 1]];
+			float blue = encoder->linear[src[3 * x + 2]];
+			const float *basis = encoder->xBasis + x * xComponents;
+			for(int i = 0; i < xComponents; i++) {
+				encoder->rowFactors[i][0] += basis[i] * red;
+				encoder->rowFactors[i][1] += basis[i] * green;
+				encoder->rowFactors[i][2] += basis[i] * blue;
+			}
+		}
+
+		for(int j = 0; j < encoder->yComponents; j++) {
+			float basis = cosf(M_PI * j * encoder->row / encoder->height);
+			for(int i = 0; i < xComponents; i++) {
+				encoder->factors[j][i][0] += basis * encoder->rowFactors[i][0];
+				encoder->factors[j][i][1] += basis * encoder->rowFactors[i][1];
+				encoder->factors[j][i][2] += basis * encoder->rowFactors[i][2];
+			}
+		}
+	}
+
+	return 0;
+}
+
+const char *blurHashEncoderFinish(BlurHashEncoder *encoder) {
+	static char buffer[BLURHASH_MAX_LENGTH + 1];
+	TRACE_RESTORE(encoder->traceScope);
+
+	if(encoder->row != encoder->height) {
+		free(encoder);
+		TRACE_ENCODE_END(BLURHASH_STREAMING, BLURHASH_RESULT_ERROR, NULL);
+		return NULL;
+	}
+
+	int xComponents = encoder->xComponents;
+	int yComponents = encoder->yComponents;
 	float factors[yComponents][xComponents][3];
-	memset(factors, 0, sizeof(factors));
 
 	for(int y = 0; y < yComponents; y++) {
 		for(int x = 0; x < xComponents; x++) {
-			float *factor = multiplyBasisFunction(x, y, width, height, rgb, bytesPerRow);
-			factors[y][x][0] = factor[0];
-			factors[y][x][1] = factor[1];
-			factors[y][x][2] = factor[2];
+			float normalisation = (x == 0 && y == 0) ? 1 : 2;
+			float scale = normalisation / (encoder->width * encoder->height);
+			factors[y][x][0] = encoder->factors[y][x][0] * scale;
+			factors[y][x][1] = encoder->factors[y][x][1] * scale;
+			factors[y][x][2] = encoder->factors[y][x][2] * scale;
 		}
 	}
 
-	float *dc = factors[0][0];
+	free(encoder);
+	encodeFactors(xComponents, yComponents, factors[0][0], buffer);
+
+	TRACE_ENCODE_END(BLURHASH_STREAMING, BLURHASH_RESULT_OK, buffer);
+	return buffer;
+}
+
+// Batch GEMM tiling: the coefficients of a batch are the product of the
+// transposed basis [components x pixels] and the linear pixels
+// [pixels x (3 * images)]. Pixels are processed in blocks of BATCH_PIXELS,
+// images in panels of BATCH_IMAGES, and components in groups of
+// BATCH_COMPONENTS, so one micro-kernel tile of accumulators stays in
+// registers while it streams through a packed panel. The basis is never
+// stored whole: each block's [components x BATCH_PIXELS] tile is the product
+// of a per-column and a per-row table, and is shared by every panel.
+#define BATCH_PIXELS 256
+#define BATCH_IMAGES 4
+#define BATCH_COLUMNS (BATCH_IMAGES * 3)
+#define BATCH_COMPONENTS 4
+
+static void batchMicroKernel(const float *basis, size_t basisStride, const float *panel, int pixels, float *coefficients, size_t coefficientStride) {
+	float acc[BATCH_COMPONENTS][BATCH_COLUMNS];
+	for(int k = 0; k < BATCH_COMPONENTS; k++) {
+		for(int c = 0; c < BATCH_COLUMNS; c++) acc[k][c] = coefficients[k * coefficientStride + c];
+	}
+
+	for(int p = 0; p < pixels; p++) {
+		const float *column = panel + p * BATCH_COLUMNS;
+		for(int k = 0; k < BATCH_COMPONENTS; k++) {
+			float b = basis[k * basisStride + p];
+			for(int c = 0; c < BATCH_COLUMNS; c++) acc[k][c] += b * column[c];
+		}
+	}
+
+	for(int k = 0; k < BATCH_COMPONENTS; k++) {
+		for(int c = 0; c < BATCH_COLUMNS; c++) coefficients[k * coefficientStride + c] = acc[k][c];
+	}
+}
+
+int blurHashForPixelsBatch(int count, int xComponents, int yComponents, int width, int height, uint8_t **rgb, size_t bytesPerRow, char **hashes) {
+	TRACE_ENCODE_START(BLURHASH_BATCH, width, height, xComponents, yComponents, count);
+	if(xComponents < 1 || xComponents > 9 || yComponents < 1 || yComponents > 9) {
+		TRACE_ENCODE_END(BLURHASH_BATCH, BLURHASH_RESULT_ERROR, NULL);
+		return -1;
+	}
+	if(count < 1) {
+		TRACE_ENCODE_END(BLURHASH_BATCH, BLURHASH_RESULT_OK, NULL);
+		return 0;
+	}
+
+	int components = xComponents * yComponents;
+	int paddedComponents = (components + BATCH_COMPONENTS - 1) / BATCH_COMPONENTS * BATCH_COMPONENTS;
+	int panels = (count + BATCH_IMAGES - 1) / BATCH_IMAGES;
+	size_t pixelCount = (size_t)width * height;
+	size_t columns = (size_t)panels * BATCH_COLUMNS;
+
+	float *xBasis = malloc((size_t)width * xComponents * sizeof(float));
+	float *yBasis = malloc((size_t)height * yComponents * sizeof(float));
+	// Zeroed so that the padding components stay zero
+	float *basis = calloc(paddedComponents * BATCH_PIXELS, sizeof(float));
+	float *coefficients = calloc(paddedComponents * columns, sizeof(float));
+	float *panel = malloc(BATCH_PIXELS * BATCH_COLUMNS * sizeof(float));
+	if(!xBasis || !yBasis || !basis || !coefficients || !panel) {
+		free(xBasis);
+		free(yBasis);
+		free(basis);
+		free(coefficients);
+		free(panel);
+		TRACE_ENCODE_END(BLURHASH_BATCH, BLURHASH_RESULT_ERROR, NULL);
+		return -1;
+	}
+
+	float linear[256];
+	for(int i = 0; i < 256; i++) linear[i] = sRGBToLinear(i);
+
+	CosineWalk xWalk = cosineWalk(1, width);
+	for(int x = 0; x < width; x++) chebyshevBasis(cosineWalkNext(&xWalk), xComponents, xBasis + x * xComponents);
+	CosineWalk yWalk = cosineWalk(1, height);
+	for(int y = 0; y < height; y++) chebyshevBasis(cosineWalkNext(&yWalk), yComponents, yBasis + y * yComponents);
+
+	for(size_t p0 = 0; p0 < pixelCount; p0 += BATCH_PIXELS) {
+		int pixels = pixelCount - p0 < BATCH_PIXELS ? pixelCount - p0 : BATCH_PIXELS;
+
+		for(int p = 0; p < pixels; p++) {
+			size_t x = (p0 + p) % width, y = (p0 + p) / width;
+			for(int j = 0; j < yComponents; j++) {
+				for(int i = 0; i < xComponents; i++) {
+					basis[(j * xComponents + i) * BATCH_PIXELS + p] = xBasis[x * xComponents + i] * yBasis[y * yComponents + j];
+				}
+			}
+		}
+
+		for(int n0 = 0; n0 < panels; n0++) {
+			for(int p = 0; p < pixels; p++) {
+				size_t x = (p0 + p) % width, y = (p0 + p) / width;
+				float *column = panel + p * BATCH_COLUMNS;
+				for(int n = 0; n < BATCH_IMAGES; n++) {
+					int image = n0 * BATCH_IMAGES + n;
+					if(image < count) {
+						const uint8_t *src = rgb[image] + y * bytesPerRow + 3 * x;
+						column[n * 3 + 0] = linear[src[0]];
+						column[n * 3 + 1] = linear[src[1]];
+						column[n * 3 + 2] = linear[src[2]];
+					} else {
+						column[n * 3 + 0] = column[n * 3 + 1] = column[n * 3 + 2] = 0;
+					}
+				}
+			}
+
+			for(int k0 = 0; k0 < paddedComponents; k0 += BATCH_COMPONENTS) {
+				batchMicroKernel(basis + k0 * BATCH_PIXELS, BATCH_PIXELS, panel, pixels,
+					coefficients + k0 * columns + n0 * BATCH_COLUMNS, columns);
+			}
+		}
+	}
+
+	for(int n = 0; n < count; n++) {
+		float factors[yComponents][xComponents][3];
+		for(int j = 0; j < yComponents; j++) {
+			for(int i = 0; i < xComponents; i++) {
+				float normalisation = (i == 0 && j == 0) ? 1 : 2;
+				float scale = normalisation / (width * height);
+				const float *c = coefficients + (j * xComponents + i) * columns + n * 3;
+				factors[j][i][0] = c[0] * scale;
+				factors[j][i][1] = c[1] * scale;
+				factors[j][i][2] = c[2] * scale;
+			}
+		}
+		encodeFactors(xComponents, yComponents, factors[0][0], hashes[n]);
+	}
+
+	free(xBasis);
+	free(yBasis);
+	free(basis);
+	free(coefficients);
+	free(panel);
+
+	TRACE_ENCODE_END(BLURHASH_BATCH, BLURHASH_RESULT_OK, hashes[0]);
+	return 0;
+}
+
+static void quantiseFactors(int xComponents, int yComponents, float *factors, int *quantised) {
+	float *dc = factors;
 	float *ac = dc + 3;
 	int acCount = xComponents * yComponents - 1;
-	char *ptr = buffer;
-
-	int sizeFlag = (xComponents - 1) + (yComponents - 1) * 9;
-	ptr = encode_int(sizeFlag, 1, ptr);
 
 	float maximumValue;
 	if(acCount > 0) {
@@ -44,30 +417,146 @@ const char *blurHashForPixels(int xComponents, int yComponents, int width, int h
 
 		int quantisedMaximumValue = fmaxf(0, fminf(82, floorf(actualMaximumValue * 166 - 0.5)));
 		maximumValue = ((float)quantisedMaximumValue + 1) / 166;
-		ptr = encode_int(quantisedMaximumValue, 1, ptr);
+		quantised[0] = quantisedMaximumValue;
 	} else {
 		maximumValue = 1;
-		ptr = encode_int(0, 1, ptr);
+		quantised[0] = 0;
+	}
+
+	quantised[1] = encodeDC(dc[0], dc[1], dc[2]);
+
+	for(int i = 0; i < acCount; i++) {
+		quantised[i + 2] = encodeAC(ac[i * 3 + 0], ac[i * 3 + 1], ac[i * 3 + 2], maximumValue);
 	}
+}
+
+// Sums one row of Q16 linear values against the Q15 x basis, into Q31.
+// Column width - x sees the basis of column x times (-1)^i, so each mirrored
+// pair is folded into a sum for the even components and a difference for the
+// odd ones, which halves the multiplies. xBasis only covers x <= width / 2.
+static void fixedRowSums(const uint8_t *src, int width, int xComponents, const int32_t *xBasis, int64_t rowSums[][3]) {
+	memset(rowSums, 0, sizeof(int64_t) * 3 * xComponents);
+
+	for(int x = 0; x <= width / 2; x++) {
+		int mirror = width - x;
+		const int32_t *basis = xBasis + x * xComponents;
+		int64_t red = fixedSRGBToLinear[src[3 * x + 0]];
+		int64_t green = fixedSRGBToLinear[src[3 * x + 1]];
+		int64_t blue = fixedSRGBToLinear[src[3 * x + 2]];
+
+		if(x == 0 || mirror == x) {
+			for(int i = 0; i < xComponents; i++) {
+				rowSums[i][0] += basis[i] * red;
+				rowSums[i][1] += basis[i] * green;
+				rowSums[i][2] += basis[i] * blue;
+			}
+			continue;
+		}
 
-	ptr = encode_int(encodeDC(dc[0], dc[1], dc[2]), 4, ptr);
+		int64_t mirrorRed = fixedSRGBToLinear[src[3 * mirror + 0]];
+		int64_t mirrorGreen = fixedSRGBToLinear[src[3 * mirror + 1]];
+		int64_t mirrorBlue = fixedSRGBToLinear[src[3 * mirror + 2]];
+		for(int i = 0; i < xComponents; i += 2) {
+			rowSums[i][0] += basis[i] * (red + mirrorRed);
+			rowSums[i][1] += basis[i] * (green + mirrorGreen);
+			rowSums[i][2] += basis[i] * (blue + mirrorBlue);
+		}
+		for(int i = 1; i < xComponents; i += 2) {
+			rowSums[i][0] += basis[i] * (red - mirrorRed);
+			rowSums[i][1] += basis[i] * (green - mirrorGreen);
+			rowSums[i][2] += basis[i] * (blue - mirrorBlue);
+		}
+	}
+}
 
+// The same quantisation as quantiseFactors() for Q31 factors, with the
+// floating point comparisons rearranged into exact integer ones.
+static void quantiseFixedFactors(int xComponents, int yComponents, int64_t *factors, int *quantised) {
+	int64_t *dc = factors;
+	int64_t *ac = dc + 3;
+	int acCount = xComponents * yComponents - 1;
+
+	// floor(maximum * 166 - 0.5), clamped to 0..82
+	int quantisedMaximumValue = 0;
+	if(acCount > 0) {
+		int64_t actualMaximumValue = 0;
+		for(int i = 0; i < acCount * 3; i++) {
+			int64_t value = ac[i] < 0 ? -ac[i] : ac[i];
+			if(value > actualMaximumValue) actualMaximumValue = value;
+		}
+		int64_t scaled = actualMaximumValue * 166 - ((int64_t)1 << 30);
+		if(scaled > 0) quantisedMaximumValue = scaled >> 31;
+		if(quantisedMaximumValue > 82) quantisedMaximumValue = 82;
+	}
+	quantised[0] = quantisedMaximumValue;
+
+	quantised[1] = (fixedLinearTosRGB(dc[0]) << 16) + (fixedLinearTosRGB(dc[1]) << 8) + fixedLinearTosRGB(dc[2]);
+
+	// floor(sqrt(value / maximum) * 9 + 9.5) steps up by one at each value where
+	// value * 324 * 166 = (2n - 1)^2 * (quantisedMaximumValue + 1) * 2^31
+	int64_t unit = (int64_t)(quantisedMaximumValue + 1) << 31;
 	for(int i = 0; i < acCount; i++) {
-		ptr = encode_int(encodeAC(ac[i * 3 + 0], ac[i * 3 + 1], ac[i * 3 + 2], maximumValue), 2, ptr);
+		int packed = 0;
+		for(int c = 0; c < 3; c++) {
+			int64_t value = ac[i * 3 + c];
+			int64_t scaled = (value < 0 ? -value : value) * 324 * 166;
+			int steps = 0;
+			while(steps < 9 && (value >= 0 ?
+				scaled >= (2 * steps + 1) * (2 * steps + 1) * unit :
+				scaled > (2 * steps + 1) * (2 * steps + 1) * unit)) steps++;
+			packed = packed * 19 + (value >= 0 ? 9 + steps : 9 - steps);
+		}
+		quantised[i + 2] = packed;
+	}
+}
+
+static char *encodeFactors(int xComponents, int yComponents, float *factors, char *destination) {
+	int quantised[xComponents * yComponents + 1];
+	quantiseFactors(xComponents, yComponents, factors, quantised);
+
+	return encodeQuantised(xComponents, yComponents, quantised, destination);
+}
+
+static char *encodeQuantised(int xComponents, int yComponents, const int *quantised, char *destination) {
+	char *ptr = destination;
+
+	int sizeFlag = (xComponents - 1) + (yComponents - 1) * 9;
+	ptr = encode_int(sizeFlag, 1, ptr);
+	ptr = encode_int(quantised[0], 1, ptr);
+	ptr = encode_int(quantised[1], 4, ptr);
+
+	for(int i = 2; i < xComponents * yComponents + 1; i++) {
+		ptr = encode_int(quantised[i], 2, ptr);
 	}
 
 	*ptr = 0;
 
-	return buffer;
+	return ptr;
+}
+
+static void computeFactors(int xComponents, int yComponents, int width, int height, uint8_t *rgb, size_t bytesPerRow, float *factors) {
+	for(int y = 0; y < yComponents; y++) {
+		for(int x = 0; x < xComponents; x++) {
+			float *factor = multiplyBasisFunction(x, y, width, height, rgb, bytesPerRow);
+			factors[(y * xComponents + x) * 3 + 0] = factor[0];
+			factors[(y * xComponents + x) * 3 + 1] = factor[1];
+			factors[(y * xComponents + x) * 3 + 2] = factor[2];
+		}
+	}
 }
 
 static float *multiplyBasisFunction(int xComponent, int yComponent, int width, int height, uint8_t *rgb, size_t bytesPerRow) {
 	float r = 0, g = 0, b = 0;
 	float normalisation = (xComponent == 0 && yComponent == 0) ? 1 : 2;
 
+	CosineWalk yWalk = cosineWalk(yComponent, height);
+	CosineWalk xStart = cosineWalk(xComponent, width);
+
 	for(int y = 0; y < height; y++) {
+		float yBasis = cosineWalkNext(&yWalk);
+		CosineWalk xWalk = xStart;
 		for(int x = 0; x < width; x++) {
-			float basis = cosf(M_PI * xComponent * x / width) * cosf(M_PI * yComponent * y / height);
+			float basis = (float)cosineWalkNext(&xWalk) * yBasis;
 			r += basis * sRGBToLinear(rgb[3 * x + 0 + y * bytesPerRow]);
 			g += basis * sRGBToLinear(rgb[3 * x + 1 + y * bytesPerRow]);
 			b += basis * sRGBToLinear(rgb[3 * x + 2 + y * bytesPerRow]);
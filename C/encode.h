@@ -4,6 +4,21 @@
 #include <stdint.h>
 #include <stdlib.h>
 
-const char *blurHashForPixels(int xComponents, int yComponents, int width, int height, uint8_t *rgb, size_t bytesPerRow);
+#include "api.h"
+
+#define BLURHASH_MAX_LENGTH (2 + 4 + (9 * 9 - 1) * 2)
+
+BLURHASH_API const char *blurHashForPixels(int xComponents, int yComponents, int width, int height, uint8_t *rgb, size_t bytesPerRow);
+BLURHASH_API const char *blurHashForPixelsFixedPoint(int xComponents, int yComponents, int width, int height, uint8_t *rgb, size_t bytesPerRow);
+BLURHASH_API const char *blurHashForFactors(int xComponents, int yComponents, float *factors);
+BLURHASH_API int blurHashFactorsForPixels(int xComponents, int yComponents, int width, int height, uint8_t *rgb, size_t bytesPerRow, float *factors, int *quantised);
+BLURHASH_API int blurHashesForPixels(int count, const int *xComponents, const int *yComponents, int width, int height, uint8_t *rgb, size_t bytesPerRow, char **hashes);
+BLURHASH_API int blurHashForPixelsBatch(int count, int xComponents, int yComponents, int width, int height, uint8_t **rgb, size_t bytesPerRow, char **hashes);
+
+typedef struct BlurHashEncoder BlurHashEncoder;
+
+BLURHASH_API BlurHashEncoder *blurHashEncoderBegin(int xComponents, int yComponents, int width, int height);
+BLURHASH_API int blurHashEncoderPushRows(BlurHashEncoder *encoder, const uint8_t *rgb, int rows, size_t bytesPerRow);
+BLURHASH_API const char *blurHashEncoderFinish(BlurHashEncoder *encoder);
 
 #endif
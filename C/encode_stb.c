@@ -1,42 +1,88 @@
 #include "encode.h"
+#include "load_stb.h"
+#include "stats.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 #include <stdio.h>
+#include <string.h>
 
-const char *blurHashForFile(int xComponents, int yComponents,const char *filename);
+// Flags for blurHashForFile(), next to the LOAD_ flags of loadImage()
+#define ENCODE_FIXED_POINT 4
+
+const char *blurHashForFile(int xComponents, int yComponents, const char *filename, int flags, Stats *stats);
 
 int main(int argc, const char **argv) {
-	if(argc != 4) {
-		fprintf(stderr, "Usage: %s x_components y_components imagefile\n", argv[0]);
+	int flags = 0;
+	Stats statsStorage, *stats = NULL;
+	int arg = 1;
+	while(arg < argc && strncmp(argv[arg], "--", 2) == 0) {
+		if(strcmp(argv[arg], "--thumbnail") == 0) flags |= LOAD_THUMBNAIL;
+		else if(strcmp(argv[arg], "--fixed-point") == 0) flags |= ENCODE_FIXED_POINT;
+		else if(strcmp(argv[arg], "--downscale") == 0) flags |= LOAD_DOWNSCALE;
+		else if(strcmp(argv[arg], "--stats") == 0) stats = &statsStorage;
+		else break;
+		arg++;
+	}
+
+	if(argc - arg < 3) {
+		fprintf(stderr, "Usage: %s [--thumbnail] [--downscale] [--fixed-point] [--stats] x_components y_components imagefile...\n", argv[0]);
 		return 1;
 	}
 
-	int xComponents = atoi(argv[1]);
-	int yComponents = atoi(argv[2]);
+	int xComponents = atoi(argv[arg]);
+	int yComponents = atoi(argv[arg + 1]);
 	if(xComponents < 1 || xComponents > 8 || yComponents < 1 || yComponents > 8) {
 		fprintf(stderr, "Component counts must be between 1 and 8.\n");
 		return 1;
 	}
 
-	const char *hash = blurHashForFile(xComponents, yComponents, argv[3]);
-	if(!hash) {
-		fprintf(stderr, "Failed to load image file \"%s\".\n", argv[3]);
-		return 1;
-	}
+	// Several files are a batch, which adds a histogram of each stage's time per image
+	int batch = argc - arg > 3, status = 0;
+	statsBegin(stats);
+	for(int file = arg + 2; file < argc; file++) {
+		const char *hash = blurHashForFile(xComponents, yComponents, argv[file], flags, stats);
+		if(!hash) {
+			fprintf(stderr, "Failed to load image file \"%s\".\n", argv[file]);
+			status = 1;
+			continue;
+		}
 
-	printf("%s\n", hash);
+		printf("%s\n", hash);
+		fflush(stdout);
+		if(stats) stats->bytesWritten += strlen(hash) + 1;
+		statsStage(stats, "output");
+		if(batch) statsItem(stats, "image");
+	}
+	statsPrint(stats, "blurhash_encoder");
 
-	return 0;
+	return status;
 }
 
-const char *blurHashForFile(int xComponents, int yComponents,const char *filename) {
-	int width, height, channels;
-	unsigned char *data = stbi_load(filename, &width, &height, &channels, 3);
+/*
+	blurHashForFile : Loads the image with loadImage and encodes it. With stats, the stages are
+					  those of loadImage, then project (computing the coefficients) and quantise
+					  (turning them into the string). The fixed-point encoder does the last two
+					  in one call, reported as encode.
+*/
+const char *blurHashForFile(int xComponents, int yComponents, const char *filename, int flags, Stats *stats) {
+	int width, height;
+	uint8_t *data = loadImage(filename, xComponents, yComponents, flags, &width, &height, stats);
 	if(!data) return NULL;
+	if(stats) stats->pixels += (uint64_t)width * height;
 
-	const char *hash = blurHashForPixels(xComponents, yComponents, width, height, data, width * 3);
+	const char *hash;
+	if(flags & ENCODE_FIXED_POINT) {
+		hash = blurHashForPixelsFixedPoint(xComponents, yComponents, width, height, data, width * 3);
+		statsStage(stats, "encode");
+	} else {
+		float factors[yComponents * xComponents * 3];
+		blurHashFactorsForPixels(xComponents, yComponents, width, height, data, width * 3, factors, NULL);
+		statsStage(stats, "project");
+		hash = blurHashForFactors(xComponents, yComponents, factors);
+		statsStage(stats, "quantise");
+	}
 
 	stbi_image_free(data);
 
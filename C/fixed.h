@@ -0,0 +1,222 @@
+#ifndef __BLURHASH_FIXED_H__
+#define __BLURHASH_FIXED_H__
+
+#include <stdint.h>
+
+/*
+	Integer building blocks for the fixed-point encoder and decoder. Every
+	table is a precomputed constant and every operation is integer, so the
+	results are the same on every platform, compiler and libm, regardless
+	of -Ofast or FMA contraction.
+*/
+
+// Linear light is Q16, basis values are Q15, and a half turn (pi) of basis
+// phase is 1 << 16 units.
+#define FIXED_LINEAR_SHIFT 16
+#define FIXED_BASIS_SHIFT 15
+#define FIXED_PHASE_PI (1 << 16)
+
+// Largest punch the fixed-point decoder applies. It keeps the Q16 colors
+// within 2^31 and every sum of their products with the basis well inside
+// 64 bits. At this punch the smallest nonzero AC color is already about 5,
+// so a pixel only stays unsaturated where the AC terms cancel exactly.
+#define FIXED_MAX_PUNCH (1 << 16)
+
+// round(sRGBToLinear(i) * 65536)
+static const int32_t fixedSRGBToLinear[256] = {
+	    0,    20,    40,    60,    80,    99,   119,   139,   159,   179,   199,   219,
+	  241,   264,   288,   313,   340,   367,   396,   427,   458,   491,   526,   562,
+	  599,   637,   677,   718,   761,   805,   851,   898,   947,   997,  1048,  1101,
+	 1156,  1212,  1270,  1330,  1391,  1453,  1517,  1583,  1651,  1720,  1791,  1863,
+	 1937,  2013,  2090,  2170,  2250,  2333,  2418,  2504,  2592,  2681,  2773,  2866,
+	 2961,  3058,  3157,  3258,  3360,  3464,  3570,  3678,  3788,  3900,  4014,  4129,
+	 4247,  4366,  4488,  4611,  4736,  4864,  4993,  5124,  5257,  5392,  5530,  5669,
+	 5810,  5953,  6099,  6246,  6395,  6547,  6701,  6856,  7014,  7174,  7336,  7500,
+	 7666,  7834,  8004,  8177,  8352,  8529,  8708,  8889,  9072,  9258,  9446,  9636,
+	 9828, 10022, 10219, 10418, 10619, 10822, 11028, 11236, 11446, 11658, 11873, 12090,
+	12309, 12531, 12754, 12981, 13209, 13440, 13673, 13909, 14147, 14387, 14629, 14874,
+	15122, 15372, 15624, 15878, 16135, 16394, 16656, 16920, 17187, 17456, 17727, 18001,
+	18278, 18556, 18838, 19121, 19408, 19696, 19988, 20281, 20578, 20876, 21178, 21481,
+	21788, 22096, 22408, 22722, 23038, 23357, 23679, 24003, 24329, 24659, 24991, 25325,
+	25662, 26002, 26344, 26689, 27036, 27387, 27739, 28095, 28453, 28813, 29177, 29543,
+	29911, 30283, 30657, 31033, 31413, 31795, 32180, 32567, 32957, 33350, 33746, 34144,
+	34545, 34949, 35355, 35765, 36177, 36591, 37009, 37429, 37852, 38278, 38707, 39138,
+	39572, 40009, 40449, 40892, 41337, 41786, 42237, 42691, 43147, 43607, 44069, 44534,
+	45003, 45474, 45947, 46424, 46904, 47386, 47871, 48360, 48851, 49345, 49842, 50342,
+	50844, 51350, 51859, 52370, 52884, 53402, 53922, 54445, 54972, 55501, 56033, 56568,
+	57106, 57647, 58191, 58738, 59288, 59841, 60397, 60956, 61518, 62083, 62651, 63222,
+	63796, 64373, 64953, 65536,
+};
+
+// round(cos(k * pi / 512) * 32768), one quarter turn
+static const int32_t fixedQuarterCos[257] = {
+	32768, 32767, 32766, 32762, 32758, 32753, 32746, 32738, 32729, 32718, 32706, 32693,
+	32679, 32664, 32647, 32629, 32610, 32590, 32568, 32546, 32522, 32496, 32470, 32442,
+	32413, 32383, 32352, 32319, 32286, 32251, 32214, 32177, 32138, 32099, 32058, 32015,
+	31972, 31927, 31881, 31834, 31786, 31737, 31686, 31634, 31581, 31527, 31471, 31415,
+	31357, 31298, 31238, 31177, 31114, 31050, 30986, 30920, 30853, 30784, 30715, 30644,
+	30572, 30499, 30425, 30350, 30274, 30196, 30118, 30038, 29957, 29875, 29792, 29707,
+	29622, 29535, 29448, 29359, 29269, 29178, 29086, 28993, 28899, 28803, 28707, 28610,
+	28511, 28411, 28311, 28209, 28106, 28002, 27897, 27791, 27684, 27576, 27467, 27357,
+	27246, 27133, 27020, 26906, 26791, 26674, 26557, 26439, 26320, 26199, 26078, 25956,
+	25833, 25708, 25583, 25457, 25330, 25202, 25073, 24943, 24812, 24680, 24548, 24414,
+	24279, 24144, 24008, 23870, 23732, 23593, 23453, 23312, 23170, 23028, 22884, 22740,
+	22595, 22449, 22302, 22154, 22006, 21856, 21706, 21555, 21403, 21251, 21097, 20943,
+	20788, 20632, 20475, 20318, 20160, 20001, 19841, 19681, 19520, 19358, 19195, 19032,
+	18868, 18703, 18538, 18372, 18205, 18037, 17869, 17700, 17531, 17361, 17190, 17018,
+	16846, 16673, 16500, 16326, 16151, 15976, 15800, 15624, 15447, 15269, 15091, 14912,
+	14733, 14553, 14373, 14192, 14010, 13828, 13646, 13463, 13279, 13095, 12910, 12725,
+	12540, 12354, 12167, 11980, 11793, 11605, 11417, 11228, 11039, 10850, 10660, 10469,
+	10279, 10088,  9896,  9704,  9512,  9319,  9127,  8933,  8740,  8546,  8351,  8157,
+	 7962,  7767,  7571,  7376,  7180,  6983,  6787,  6590,  6393,  6195,  5998,  5800,
+	 5602,  5404,  5205,  5007,  4808,  4609,  4410,  4211,  4011,  3812,  3612,  3412,
+	 3212,  3012,  2811,  2611,  2411,  2210,  2009,  1809,  1608,  1407,  1206,  1005,
+	  804,   603,   402,   201,     0,
+};
+
+// round(sRGBToLinear((c - 0.5) / 255) * 2^31) for c = 1..255: the Q31 linear
+// value from which linearTosRGB() rounds up to c
+static const uint32_t fixedSRGBThresholds[255] = {
+	    325910,     977729,    1629548,    2281367,    2933187,    3585006,    4236825,    4888644,
+	   5540463,    6192283,    6846824,    7536077,    8264193,    9031775,    9839411,   10687677,
+	  11577136,   12508342,   13481837,   14498151,   15557807,   16661317,   17809186,   19001908,
+	  20239971,   21523854,   22854030,   24230963,   25655111,   27126927,   28646855,   30215335,
+	  31832800,   33499678,   35216390,   36983354,   38800981,   40669678,   42589847,   44561885,
+	  46586185,   48663136,   50793121,   52976521,   55213712,   57505065,   59850950,   62251730,
+	  64707767,   67219418,   69787037,   72410976,   75091581,   77829197,   80624166,   83476825,
+	  86387510,   89356553,   92384284,   95471030,   98617115,  101822860,  105088584,  108414604,
+	 111801234,  115248785,  118757567,  122327885,  125960045,  129654350,  133411098,  137230589,
+	 141113118,  145058979,  149068463,  153141861,  157279460,  161481546,  165748404,  170080314,
+	 174477559,  178940415,  183469161,  188064070,  192725417,  197453473,  202248508,  207110790,
+	 212040586,  217038162,  222103781,  227237706,  232440196,  237711511,  243051909,  248461646,
+	 253940977,  259490155,  265109433,  270799061,  276559289,  282390365,  288292535,  294266046,
+	 300311140,  306428062,  312617054,  318878355,  325212205,  331618843,  338098505,  344651427,
+	 351277845,  357977991,  364752099,  371600399,  378523122,  385520498,  392592755,  399740119,
+	 406962817,  414261075,  421635116,  429085163,  436611440,  444214166,  451893563,  459649849,
+	 467483244,  475393963,  483382225,  491448245,  499592237,  507814416,  516114994,  524494183,
+	 532952195,  541489241,  550105529,  558801269,  567576669,  576431935,  585367275,  594382893,
+	 603478994,  612655783,  621913462,  631252235,  640672302,  650173865,  659757124,  669422278,
+	 679169526,  688999066,  698911096,  708905812,  718983409,  729144084,  739388031,  749715443,
+	 760126514,  770621436,  781200401,  791863601,  802611226,  813443465,  824360508,  835362544,
+	 846449761,  857622345,  868880485,  880224365,  891654173,  903170091,  914772306,  926461000,
+	 938236357,  950098560,  962047790,  974084229,  986208059,  998419458, 1010718608, 1023105687,
+	1035580873, 1048144347, 1060796283, 1073536861, 1086366256, 1099284645, 1112292202, 1125389104,
+	1138575524, 1151851636, 1165217614, 1178673631, 1192219860, 1205856471, 1219583638, 1233401530,
+	1247310318, 1261310173, 1275401263, 1289583759, 1303857828, 1318223639, 1332681360, 1347231157,
+	1361873197, 1376607648, 1391434674, 1406354441, 1421367115, 1436472859, 1451671838, 1466964215,
+	1482350155, 1497829819, 1513403370, 1529070970, 1544832781, 1560688964, 1576639679, 1592685087,
+	1608825348, 1625060622, 1641391067, 1657816842, 1674338105, 1690955016, 1707667730, 1724476406,
+	1741381199, 1758382268, 1775479766, 1792673851, 1809964677, 1827352399, 1844837173, 1862419151,
+	1880098488, 1897875337, 1915749851, 1933722183, 1951792486, 1969960911, 1988227610, 2006592734,
+	2025056434, 2043618861, 2062280165, 2081040496, 2099900003, 2118858837, 2137917145,
+};
+
+// linearTosRGB() of the Q31 linear value k << 21, the starting point of
+// fixedLinearTosRGB()
+static const uint8_t fixedLinearTosRGBStart[1024] = {
+	  0,   3,   6,  10,  13,  15,  18,  20,  22,  23,  25,  27,  28,  30,  31,  32,
+	 34,  35,  36,  37,  38,  39,  40,  41,  42,  43,  44,  45,  46,  47,  48,  49,
+	 49,  50,  51,  52,  53,  53,  54,  55,  56,  56,  57,  58,  58,  59,  60,  60,
+	 61,  62,  62,  63,  64,  64,  65,  66,  66,  67,  67,  68,  68,  69,  70,  70,
+	 71,  71,  72,  72,  73,  73,  74,  74,  75,  75,  76,  77,  77,  77,  78,  78,
+	 79,  79,  80,  80,  81,  81,  82,  82,  83,  83,  84,  84,  85,  85,  85,  86,
+	 86,  87,  87,  88,  88,  88,  89,  89,  90,  90,  91,  91,  91,  92,  92,  93,
+	 93,  93,  94,  94,  95,  95,  95,  96,  96,  96,  97,  97,  98,  98,  98,  99,
+	 99,  99, 100, 100, 101, 101, 101, 102, 102, 102, 103, 103, 103, 104, 104, 104,
+	105, 105, 105, 106, 106, 106, 107, 107, 107, 108, 108, 108, 109, 109, 109, 110,
+	110, 110, 111, 111, 111, 112, 112, 112, 113, 113, 113, 114, 114, 114, 115, 115,
+	115, 115, 116, 116, 116, 117, 117, 117, 118, 118, 118, 118, 119, 119, 119, 120,
+	120, 120, 120, 121, 121, 121, 122, 122, 122, 122, 123, 123, 123, 124, 124, 124,
+	124, 125, 125, 125, 126, 126, 126, 126, 127, 127, 127, 127, 128, 128, 128, 129,
+	129, 129, 129, 130, 130, 130, 130, 131, 131, 131, 131, 132, 132, 132, 132, 133,
+	133, 133, 133, 134, 134, 134, 134, 135, 135, 135, 135, 136, 136, 136, 136, 137,
+	137, 137, 137, 138, 138, 138, 138, 139, 139, 139, 139, 140, 140, 140, 140, 141,
+	141, 141, 141, 142, 142, 142, 142, 142, 143, 143, 143, 143, 144, 144, 144, 144,
+	145, 145, 145, 145, 145, 146, 146, 146, 146, 147, 147, 147, 147, 147, 148, 148,
+	148, 148, 149, 149, 149, 149, 149, 150, 150, 150, 150, 151, 151, 151, 151, 151,
+	152, 152, 152, 152, 153, 153, 153, 153, 153, 154, 154, 154, 154, 154, 155, 155,
+	155, 155, 155, 156, 156, 156, 156, 157, 157, 157, 157, 157, 158, 158, 158, 158,
+	158, 159, 159, 159, 159, 159, 160, 160, 160, 160, 160, 161, 161, 161, 161, 161,
+	162, 162, 162, 162, 162, 163, 163, 163, 163, 163, 164, 164, 164, 164, 164, 165,
+	165, 165, 165, 165, 166, 166, 166, 166, 166, 166, 167, 167, 167, 167, 167, 168,
+	168, 168, 168, 168, 169, 169, 169, 169, 169, 170, 170, 170, 170, 170, 170, 171,
+	171, 171, 171, 171, 172, 172, 172, 172, 172, 172, 173, 173, 173, 173, 173, 174,
+	174, 174, 174, 174, 174, 175, 175, 175, 175, 175, 176, 176, 176, 176, 176, 176,
+	177, 177, 177, 177, 177, 177, 178, 178, 178, 178, 178, 179, 179, 179, 179, 179,
+	179, 180, 180, 180, 180, 180, 180, 181, 181, 181, 181, 181, 181, 182, 182, 182,
+	182, 182, 183, 183, 183, 183, 183, 183, 184, 184, 184, 184, 184, 184, 185, 185,
+	185, 185, 185, 185, 186, 186, 186, 186, 186, 186, 187, 187, 187, 187, 187, 187,
+	188, 188, 188, 188, 188, 188, 188, 189, 189, 189, 189, 189, 189, 190, 190, 190,
+	190, 190, 190, 191, 191, 191, 191, 191, 191, 192, 192, 192, 192, 192, 192, 193,
+	193, 193, 193, 193, 193, 193, 194, 194, 194, 194, 194, 194, 195, 195, 195, 195,
+	195, 195, 195, 196, 196, 196, 196, 196, 196, 197, 197, 197, 197, 197, 197, 198,
+	198, 198, 198, 198, 198, 198, 199, 199, 199, 199, 199, 199, 199, 200, 200, 200,
+	200, 200, 200, 201, 201, 201, 201, 201, 201, 201, 202, 202, 202, 202, 202, 202,
+	202, 203, 203, 203, 203, 203, 203, 204, 204, 204, 204, 204, 204, 204, 205, 205,
+	205, 205, 205, 205, 205, 206, 206, 206, 206, 206, 206, 206, 207, 207, 207, 207,
+	207, 207, 207, 208, 208, 208, 208, 208, 208, 208, 209, 209, 209, 209, 209, 209,
+	209, 210, 210, 210, 210, 210, 210, 210, 211, 211, 211, 211, 211, 211, 211, 212,
+	212, 212, 212, 212, 212, 212, 213, 213, 213, 213, 213, 213, 213, 214, 214, 214,
+	214, 214, 214, 214, 214, 215, 215, 215, 215, 215, 215, 215, 216, 216, 216, 216,
+	216, 216, 216, 217, 217, 217, 217, 217, 217, 217, 217, 218, 218, 218, 218, 218,
+	218, 218, 219, 219, 219, 219, 219, 219, 219, 219, 220, 220, 220, 220, 220, 220,
+	220, 221, 221, 221, 221, 221, 221, 221, 221, 222, 222, 222, 222, 222, 222, 222,
+	223, 223, 223, 223, 223, 223, 223, 223, 224, 224, 224, 224, 224, 224, 224, 224,
+	225, 225, 225, 225, 225, 225, 225, 226, 226, 226, 226, 226, 226, 226, 226, 227,
+	227, 227, 227, 227, 227, 227, 227, 228, 228, 228, 228, 228, 228, 228, 228, 229,
+	229, 229, 229, 229, 229, 229, 229, 230, 230, 230, 230, 230, 230, 230, 230, 231,
+	231, 231, 231, 231, 231, 231, 231, 232, 232, 232, 232, 232, 232, 232, 232, 233,
+	233, 233, 233, 233, 233, 233, 233, 234, 234, 234, 234, 234, 234, 234, 234, 235,
+	235, 235, 235, 235, 235, 235, 235, 236, 236, 236, 236, 236, 236, 236, 236, 236,
+	237, 237, 237, 237, 237, 237, 237, 237, 238, 238, 238, 238, 238, 238, 238, 238,
+	239, 239, 239, 239, 239, 239, 239, 239, 239, 240, 240, 240, 240, 240, 240, 240,
+	240, 241, 241, 241, 241, 241, 241, 241, 241, 242, 242, 242, 242, 242, 242, 242,
+	242, 242, 243, 243, 243, 243, 243, 243, 243, 243, 243, 244, 244, 244, 244, 244,
+	244, 244, 244, 245, 245, 245, 245, 245, 245, 245, 245, 245, 246, 246, 246, 246,
+	246, 246, 246, 246, 246, 247, 247, 247, 247, 247, 247, 247, 247, 248, 248, 248,
+	248, 248, 248, 248, 248, 248, 249, 249, 249, 249, 249, 249, 249, 249, 249, 250,
+	250, 250, 250, 250, 250, 250, 250, 250, 251, 251, 251, 251, 251, 251, 251, 251,
+	251, 252, 252, 252, 252, 252, 252, 252, 252, 252, 253, 253, 253, 253, 253, 253,
+	253, 253, 253, 254, 254, 254, 254, 254, 254, 254, 254, 254, 255, 255, 255, 255,
+};
+
+// cos(pi * phase / FIXED_PHASE_PI) in Q15, interpolating the quarter-turn table
+static inline int32_t fixedCos(uint32_t phase) {
+	phase &= 2 * FIXED_PHASE_PI - 1;
+	int negate = phase > FIXED_PHASE_PI / 2 && phase < 3 * FIXED_PHASE_PI / 2;
+	if(phase > FIXED_PHASE_PI) phase = 2 * FIXED_PHASE_PI - phase;
+	if(phase > FIXED_PHASE_PI / 2) phase = FIXED_PHASE_PI - phase;
+
+	uint32_t index = phase >> 7, fraction = phase & 127;
+	int32_t value = index == 256 ? fixedQuarterCos[256] :
+		(fixedQuarterCos[index] * (int32_t)(128 - fraction) + fixedQuarterCos[index + 1] * (int32_t)fraction + 64) >> 7;
+	return negate ? -value : value;
+}
+
+// cos(pi * component * position / size) in Q15. Positions past the middle
+// are mirrored, so fixedBasis(k, size - x, size) is exactly (-1)^k times
+// fixedBasis(k, x, size) even where the phase rounds a tie.
+static inline int32_t fixedBasis(int component, int position, int size) {
+	if(2 * (int64_t)position > size) {
+		int32_t mirrored = fixedBasis(component, size - position, size);
+		return component & 1 ? -mirrored : mirrored;
+	}
+	uint64_t phase = ((uint64_t)component * position * 2 * FIXED_PHASE_PI + size) / (2 * (uint64_t)size);
+	return fixedCos((uint32_t)phase);
+}
+
+// Integer division rounding halves away from zero
+static inline int64_t fixedDivide(int64_t value, int64_t divisor) {
+	return value >= 0 ? (value + divisor / 2) / divisor : -((-value + divisor / 2) / divisor);
+}
+
+// linearTosRGB() for a Q31 linear value
+static inline int fixedLinearTosRGB(int64_t value) {
+	if(value <= 0) return 0;
+	if(value >= (int64_t)1 << 31) return 255;
+	int code = fixedLinearTosRGBStart[value >> 21];
+	while(code < 255 && value >= (int64_t)fixedSRGBThresholds[code]) code++;
+	return code;
+}
+
+#endif
@@ -0,0 +1,157 @@
+#include "load_stb.h"
+
+#include "stb_image.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The EXIF APP1 segment has to come before the image data, at most after a
+// JFIF APP0 segment, and each segment is at most 65535 bytes long.
+#define EXIF_SEARCH_BYTES (2 + 2 * (2 + 65535))
+
+// A thumbnail is only used when its aspect ratio is within 1/50 of the main
+// image's.
+#define THUMBNAIL_ASPECT_TOLERANCE 50
+
+static uint8_t *convertToRGB(uint8_t *pixels, int channels, int width, int height);
+static uint8_t *loadExifThumbnail(const uint8_t *buffer, size_t length, int *width, int *height);
+
+uint8_t *loadImage(const char *filename, int xComponents, int yComponents, int flags, int *width, int *height, Stats *stats) {
+	FILE *f = fopen(filename, "rb");
+	if(!f) return NULL;
+	uint8_t *data = NULL;
+	long length = -1;
+	if(fseek(f, 0, SEEK_END) == 0 && (length = ftell(f)) > 0 && fseek(f, 0, SEEK_SET) == 0) data = malloc(length);
+	if(data && fread(data, 1, length, f) != (size_t)length) {
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+	if(!data) return NULL;
+	if(stats) stats->bytesRead += length;
+	statsStage(stats, "read");
+
+	uint8_t *pixels = loadImageFromMemory(data, length, xComponents, yComponents, flags, width, height, stats);
+	free(data);
+	return pixels;
+}
+
+uint8_t *loadImageFromMemory(const uint8_t *data, size_t length, int xComponents, int yComponents, int flags, int *width, int *height, Stats *stats) {
+	int fullWidth, fullHeight, channels;
+	if(length > INT_MAX || !stbi_info_from_memory(data, (int)length, &fullWidth, &fullHeight, &channels)) return NULL;
+
+	uint8_t *pixels = NULL;
+	if(flags & LOAD_THUMBNAIL) {
+		pixels = loadExifThumbnail(data, length, width, height);
+		if(pixels && ((int64_t)llabs((int64_t)*width * fullHeight - (int64_t)*height * fullWidth) * THUMBNAIL_ASPECT_TOLERANCE > (int64_t)fullWidth * *height ||
+			*width < xComponents * MIN_PIXELS_PER_COMPONENT || *height < yComponents * MIN_PIXELS_PER_COMPONENT)) {
+			stbi_image_free(pixels);
+			pixels = NULL;
+		}
+		statsStage(stats, "thumbnail");
+		if(pixels) return pixels;
+	}
+
+	int shift = flags & LOAD_DOWNSCALE ? loadDownscaleShift(xComponents, yComponents, fullWidth, fullHeight) : 0;
+	stbi_set_downscale_on_load(shift);
+	// Only a reduced scale leaves scans that carry nothing it uses
+	stbi_set_progressive_early_stop_on_load(shift > 0);
+	// Load in the file's own channel count and convert separately, so that
+	// the conversion shows up as its own stage
+	pixels = stbi_load_from_memory(data, (int)length, width, height, &channels, 0);
+	stbi_set_downscale_on_load(0);
+	stbi_set_progressive_early_stop_on_load(0);
+	if(!pixels) return NULL;
+	statsStage(stats, "load");
+	pixels = convertToRGB(pixels, channels, *width, *height);
+	statsStage(stats, "convert");
+	return pixels;
+}
+
+int loadDownscaleShift(int xComponents, int yComponents, int width, int height) {
+	int shift = 3;
+	while(shift > 0 && ((width >> shift) < xComponents * MIN_PIXELS_PER_COMPONENT ||
+		(height >> shift) < yComponents * MIN_PIXELS_PER_COMPONENT)) shift--;
+	return shift;
+}
+
+// Converts grey, grey and alpha, or RGBA pixels to RGB the way stb_image does,
+// dropping alpha, and frees the original. Returns NULL on failure.
+static uint8_t *convertToRGB(uint8_t *pixels, int channels, int width, int height) {
+	if(channels == 3) return pixels;
+	size_t count = (size_t)width * height;
+	uint8_t *rgb = channels >= 1 && channels <= 4 ? malloc(count * 3) : NULL;
+	if(rgb) {
+		for(size_t i = 0; i < count; i++) {
+			const uint8_t *pixel = pixels + i * channels;
+			rgb[i * 3 + 0] = pixel[0];
+			rgb[i * 3 + 1] = pixel[channels >= 3 ? 1 : 0];
+			rgb[i * 3 + 2] = pixel[channels >= 3 ? 2 : 0];
+		}
+	}
+	stbi_image_free(pixels);
+	return rgb;
+}
+
+static unsigned int readExifInt(const uint8_t *p, int bytes, int bigEndian) {
+	unsigned int value = 0;
+	for(int i = 0; i < bytes; i++) {
+		value |= (unsigned int)p[bigEndian ? i : bytes - 1 - i] << (8 * (bytes - 1 - i));
+	}
+	return value;
+}
+
+// Finds the JPEG thumbnail in IFD1 of the EXIF block of a JPEG file and
+// decodes it. Returns NULL if there is none.
+static uint8_t *loadExifThumbnail(const uint8_t *buffer, size_t length, int *width, int *height) {
+	if(length > EXIF_SEARCH_BYTES) length = EXIF_SEARCH_BYTES;
+
+	uint8_t *thumbnail = NULL;
+	const uint8_t *tiff = NULL;
+	size_t tiffLength = 0;
+
+	if(length >= 4 && buffer[0] == 0xff && buffer[1] == 0xd8) {
+		size_t pos = 2;
+		while(pos + 4 <= length && buffer[pos] == 0xff) {
+			int marker = buffer[pos + 1];
+			size_t segmentLength = readExifInt(buffer + pos + 2, 2, 1);
+			if(marker == 0xda || segmentLength < 2 || pos + 2 + segmentLength > length) break;
+			if(marker == 0xe1 && segmentLength >= 8 + 8 && memcmp(buffer + pos + 4, "Exif\0\0", 6) == 0) {
+				tiff = buffer + pos + 10;
+				tiffLength = segmentLength - 8;
+				break;
+			}
+			pos += 2 + segmentLength;
+		}
+	}
+
+	if(tiff && (memcmp(tiff, "MM\0*", 4) == 0 || memcmp(tiff, "II*\0", 4) == 0)) {
+		int bigEndian = tiff[0] == 'M';
+		size_t ifd0 = readExifInt(tiff + 4, 4, bigEndian);
+		if(ifd0 + 2 <= tiffLength) {
+			size_t entries = readExifInt(tiff + ifd0, 2, bigEndian);
+			size_t next = ifd0 + 2 + 12 * entries;
+			size_t ifd1 = next + 4 <= tiffLength ? readExifInt(tiff + next, 4, bigEndian) : 0;
+			size_t offset = 0, size = 0;
+			if(ifd1 && ifd1 + 2 <= tiffLength) {
+				entries = readExifInt(tiff + ifd1, 2, bigEndian);
+				for(size_t i = 0; i < entries && ifd1 + 2 + 12 * (i + 1) <= tiffLength; i++) {
+					const uint8_t *entry = tiff + ifd1 + 2 + 12 * i;
+					unsigned int tag = readExifInt(entry, 2, bigEndian);
+					if(tag == 0x0201) offset = readExifInt(entry + 8, 4, bigEndian);
+					else if(tag == 0x0202) size = readExifInt(entry + 8, 4, bigEndian);
+				}
+			}
+			if(offset && size && offset + size <= tiffLength) {
+				int channels;
+				stbi_set_downscale_on_load(0);
+				stbi_set_progressive_early_stop_on_load(0);
+				thumbnail = stbi_load_from_memory(tiff + offset, (int)size, width, height, &channels, 3);
+			}
+		}
+	}
+
+	return thumbnail;
+}
@@ -0,0 +1,46 @@
+#ifndef __BLURHASH_LOAD_STB_H__
+#define __BLURHASH_LOAD_STB_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stats.h"
+
+/*
+	Image loading for the command-line encoder and the accuracy report, on
+	top of stb_image. The program that links load_stb.c also defines
+	STB_IMAGE_IMPLEMENTATION.
+*/
+
+// Smallest number of decoded pixels per component, along each axis, that a
+// reduced-scale decode or a thumbnail must keep.
+#define MIN_PIXELS_PER_COMPONENT 16
+
+// Flags for loadImage()
+#define LOAD_THUMBNAIL 1	// Use the EXIF thumbnail of a JPEG when it is large enough
+#define LOAD_DOWNSCALE 2	// Decode JPEGs at a reduced scale picked by loadDownscaleShift()
+
+/*
+	loadImage : Loads an image file as 8-bit RGB, for a hash with xComponents * yComponents.
+				With stats, the stages are read (reading the file), thumbnail (finding and
+				decoding the EXIF thumbnail), load (decompressing the image in its own channel
+				count) and convert (to 8-bit RGB).
+	Returns : The pixels, which the caller frees with stbi_image_free, or NULL if the file
+			  cannot be read or decoded. width and height are set to the size of the pixels,
+			  which is smaller than the image when a thumbnail or a reduced scale was used.
+*/
+uint8_t *loadImage(const char *filename, int xComponents, int yComponents, int flags, int *width, int *height, Stats *stats);
+
+/*
+	loadImageFromMemory : Same as loadImage, for a file that is already in memory.
+*/
+uint8_t *loadImageFromMemory(const uint8_t *data, size_t length, int xComponents, int yComponents, int flags, int *width, int *height, Stats *stats);
+
+/*
+	loadDownscaleShift : The log2 of the largest JPEG downscale factor, up to 8, that keeps at least
+						 MIN_PIXELS_PER_COMPONENT pixels per component along each axis of an image
+						 of width * height pixels.
+*/
+int loadDownscaleShift(int xComponents, int yComponents, int width, int height);
+
+#endif
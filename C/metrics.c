@@ -0,0 +1,147 @@
+#include "metrics.h"
+#include "counters.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef BLURHASH_METRICS
+
+enum {
+	COUNTER_CALLS,
+	COUNTER_PIXELS,
+	COUNTER_NANOSECONDS,
+	COUNTER_ERRORS,
+	COUNTER_INVALID_HASHES,
+	COUNTERS
+};
+
+/*
+	One block per thread that has called the library. Only its own thread
+	writes to a block, with a relaxed load and store rather than an atomic
+	add, and readers may see a count that is one call behind. Blocks are
+	pushed onto the list once and never freed, so the counts of threads that
+	have exited stay in the totals.
+*/
+typedef struct MetricsBlock {
+	struct MetricsBlock *next;
+	_Atomic uint64_t counters[BLURHASH_OPS][BLURHASH_MODES][COUNTERS];
+} MetricsBlock;
+
+static _Atomic(MetricsBlock *) blocks;
+static _Thread_local MetricsBlock *threadBlock;
+
+static const char *const opNames[BLURHASH_OPS] = { "encode", "decode" };
+
+static const struct {
+	const char *name, *help;
+} counterInfo[COUNTERS] = {
+	{ "blurhash_calls_total", "Calls into the BlurHash entry points." },
+	{ "blurhash_pixels_total", "Pixels encoded or decoded, once per hash, by successful calls." },
+	{ "blurhash_seconds_total", "Time spent in the BlurHash entry points." },
+	{ "blurhash_errors_total", "Calls that failed, including invalid hashes." },
+	{ "blurhash_invalid_hashes_total", "Decoder calls that rejected an invalid hash." },
+};
+
+static MetricsBlock *metricsThreadBlock(void);
+static int hasSeries(int op, int mode, int counter);
+static int appendText(char *buffer, size_t size, size_t *length, const char *format, ...);
+
+uint64_t blurHashMetricsNow(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void blurHashMetricsRecord(BlurHashOp op, BlurHashMode mode, int result, uint64_t pixels, uint64_t ns) {
+	MetricsBlock *block = metricsThreadBlock();
+	if(!block) return;
+
+	uint64_t add[COUNTERS] = { 1, result == BLURHASH_RESULT_OK ? pixels : 0, ns,
+		result != BLURHASH_RESULT_OK, result == BLURHASH_RESULT_INVALID_HASH };
+	_Atomic uint64_t *counters = block->counters[op][mode];
+	for(int i = 0; i < COUNTERS; i++) {
+		if(!add[i]) continue;
+		uint64_t value = atomic_load_explicit(&counters[i], memory_order_relaxed);
+		atomic_store_explicit(&counters[i], value + add[i], memory_order_relaxed);
+	}
+}
+
+int blurHashMetricsWrite(char *buffer, size_t size) {
+	uint64_t totals[BLURHASH_OPS][BLURHASH_MODES][COUNTERS] = { { { 0 } } };
+	MetricsBlock *block = atomic_load_explicit(&blocks, memory_order_acquire);
+	for(; block; block = block->next) {
+		for(int op = 0; op < BLURHASH_OPS; op++) {
+			for(int mode = 0; mode < BLURHASH_MODES; mode++) {
+				for(int i = 0; i < COUNTERS; i++) {
+					totals[op][mode][i] += atomic_load_explicit(&block->counters[op][mode][i], memory_order_relaxed);
+				}
+			}
+		}
+	}
+
+	size_t length = 0;
+	for(int i = 0; i < COUNTERS; i++) {
+		if(appendText(buffer, size, &length, "# HELP %s %s\n# TYPE %s counter\n",
+			counterInfo[i].name, counterInfo[i].help, counterInfo[i].name) == -1) return -1;
+		for(int op = 0; op < BLURHASH_OPS; op++) {
+			for(int mode = 0; mode < BLURHASH_MODES; mode++) {
+				if(!hasSeries(op, mode, i)) continue;
+				int written = i == COUNTER_NANOSECONDS ?
+					appendText(buffer, size, &length, "%s{op=\"%s\",mode=\"%s\"} %llu.%09llu\n", counterInfo[i].name,
+						opNames[op], blurHashModeName(mode), (unsigned long long)(totals[op][mode][i] / 1000000000),
+						(unsigned long long)(totals[op][mode][i] % 1000000000)) :
+					appendText(buffer, size, &length, "%s{op=\"%s\",mode=\"%s\"} %llu\n", counterInfo[i].name,
+						opNames[op], blurHashModeName(mode), (unsigned long long)totals[op][mode][i]);
+				if(written == -1) return -1;
+			}
+		}
+	}
+	return (int)length;
+}
+
+static MetricsBlock *metricsThreadBlock(void) {
+	if(threadBlock) return threadBlock;
+
+	MetricsBlock *block = malloc(sizeof(MetricsBlock));
+	if(!block) return NULL;
+	for(int op = 0; op < BLURHASH_OPS; op++) {
+		for(int mode = 0; mode < BLURHASH_MODES; mode++) {
+			for(int i = 0; i < COUNTERS; i++) atomic_init(&block->counters[op][mode][i], 0);
+		}
+	}
+
+	// The release makes the zeroed counters and next visible to readers along with the block
+	block->next = atomic_load_explicit(&blocks, memory_order_relaxed);
+	while(!atomic_compare_exchange_weak_explicit(&blocks, &block->next, block, memory_order_release, memory_order_relaxed));
+
+	return threadBlock = block;
+}
+
+// Only the entry points that exist get a series, and only decoders see hashes
+static int hasSeries(int op, int mode, int counter) {
+	if(op == BLURHASH_ENCODE) return counter != COUNTER_INVALID_HASHES;
+	return mode == BLURHASH_REFERENCE || mode == BLURHASH_FIXED_POINT || mode == BLURHASH_BATCH;
+}
+
+static int appendText(char *buffer, size_t size, size_t *length, const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	int written = vsnprintf(buffer + *length, size - *length, format, args);
+	va_end(args);
+	if(written < 0 || (size_t)written >= size - *length) return -1;
+	*length += written;
+	return 0;
+}
+
+#else
+
+int blurHashMetricsWrite(char *buffer, size_t size) {
+	if(size < 1) return -1;
+	buffer[0] = 0;
+	return 0;
+}
+
+#endif
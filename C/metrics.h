@@ -0,0 +1,36 @@
+#ifndef __BLURHASH_METRICS_H__
+#define __BLURHASH_METRICS_H__
+
+#include <stddef.h>
+
+#include "api.h"
+
+/*
+	Counters for every public encoder and decoder entry point, kept when the
+	library is built with BLURHASH_METRICS defined (make METRICS=1) and
+	metrics.c. Each thread counts into its own block, so recording never takes
+	a lock or a contended atomic; blurHashMetricsWrite() adds the blocks up.
+	Without BLURHASH_METRICS, metrics.c only has a blurHashMetricsWrite() that
+	writes no metrics, so the library always exports it. The recording side,
+	used by the hooks in trace.h, is internal and lives in counters.h.
+*/
+
+/*
+	blurHashMetricsWrite : Writes all counters, summed over every thread that has called the library,
+						   in the Prometheus text exposition format. The series are
+							   blurhash_calls_total, blurhash_pixels_total, blurhash_seconds_total,
+							   blurhash_errors_total and blurhash_invalid_hashes_total,
+						   labelled with op (encode or decode) and mode (reference, fixed-point,
+						   factors, multi, batch or streaming).
+						   Pixels are counted once per hash produced or decoded, for successful calls.
+						   Errors include invalid hashes. Streaming calls count the time from
+						   blurHashEncoderBegin to blurHashEncoderFinish.
+	Parameters :
+		buffer : Where to write the text, followed by a terminating zero. 8192 bytes are always enough.
+		size : Size of buffer in bytes
+	Returns : int, the length of the text without the terminating zero, or -1 if it did not fit.
+			  Without BLURHASH_METRICS, writes an empty string and returns 0.
+*/
+BLURHASH_API int blurHashMetricsWrite(char *buffer, size_t size);
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef __BLURHASH_STATS_H__
+#define __BLURHASH_STATS_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+/*
+	Per-stage statistics for the command-line tools' --stats option. A tool
+	times each stage with statsStage(), counts bytes and pixels, and calls
+	statsPrint() once at the end, which writes one JSON object to stderr.
+	Stages that run once per item of a batch also go into a histogram of
+	power-of-two nanosecond buckets, either sample by sample with
+	statsSample() or, for every stage at once, with statsItem() at the end of
+	each item. All functions do nothing when stats is
+	NULL, so the tools pass NULL when --stats is not given.
+*/
+
+#define STATS_MAX_STAGES 8
+#define STATS_BUCKETS 64
+#define STATS_MAX_NAME 48
+
+typedef struct {
+	const char *name;
+	uint64_t ns;
+	uint64_t itemNs;	// Time since the last statsItem()
+	int inItem;			// Whether the stage ran since the last statsItem()
+} StatsStage;
+
+typedef struct {
+	char name[STATS_MAX_NAME];
+	uint64_t count, totalNs, minNs, maxNs;
+	uint64_t buckets[STATS_BUCKETS];
+} StatsHistogram;
+
+typedef struct {
+	uint64_t startNs, lastNs;
+	StatsStage stages[STATS_MAX_STAGES];
+	int stageCount;
+	StatsHistogram histograms[STATS_MAX_STAGES];
+	int histogramCount;
+	uint64_t bytesRead, bytesWritten, pixels;
+} Stats;
+
+static inline uint64_t statsNow(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline void statsBegin(Stats *stats) {
+	if(!stats) return;
+	memset(stats, 0, sizeof(*stats));
+	stats->startNs = stats->lastNs = statsNow();
+}
+
+/*
+	statsStage : Adds the time since the previous stage (or statsBegin) to the named stage.
+				 Stages are printed in the order they first appear.
+*/
+static inline void statsStage(Stats *stats, const char *name) {
+	if(!stats) return;
+	uint64_t now = statsNow();
+	int i = 0;
+	while(i < stats->stageCount && strcmp(stats->stages[i].name, name) != 0) i++;
+	if(i == stats->stageCount) {
+		if(i == STATS_MAX_STAGES) return;
+		stats->stages[i].name = name;
+		stats->stageCount++;
+	}
+	stats->stages[i].ns += now - stats->lastNs;
+	stats->stages[i].itemNs += now - stats->lastNs;
+	stats->stages[i].inItem = 1;
+	stats->lastNs = now;
+}
+
+/*
+	statsSample : Adds one sample of ns nanoseconds to the named histogram.
+*/
+static inline void statsSample(Stats *stats, const char *name, uint64_t ns) {
+	if(!stats) return;
+	int i = 0;
+	while(i < stats->histogramCount && strcmp(stats->histograms[i].name, name) != 0) i++;
+	if(i == stats->histogramCount) {
+		if(i == STATS_MAX_STAGES) return;
+		snprintf(stats->histograms[i].name, STATS_MAX_NAME, "%s", name);
+		stats->histograms[i].minNs = UINT64_MAX;
+		stats->histogramCount++;
+	}
+	StatsHistogram *histogram = &stats->histograms[i];
+	int bucket = 0;
+	while(bucket < STATS_BUCKETS - 1 && ns >= (uint64_t)1 << bucket) bucket++;
+	histogram->buckets[bucket]++;
+	histogram->count++;
+	histogram->totalNs += ns;
+	if(ns < histogram->minNs) histogram->minNs = ns;
+	if(ns > histogram->maxNs) histogram->maxNs = ns;
+}
+
+/*
+	statsItem : Ends one item of a batch, such as an image. Each stage that ran since the previous
+				statsItem (or statsBegin) adds its time to the histogram <stage>_ns_per_<item>.
+*/
+static inline void statsItem(Stats *stats, const char *item) {
+	if(!stats) return;
+	for(int i = 0; i < stats->stageCount; i++) {
+		StatsStage *stage = &stats->stages[i];
+		if(!stage->inItem) continue;
+		char name[STATS_MAX_NAME];
+		snprintf(name, sizeof(name), "%s_ns_per_%s", stage->name, item);
+		statsSample(stats, name, stage->itemNs);
+		stage->itemNs = 0;
+		stage->inItem = 0;
+	}
+}
+
+// Size of a file in bytes, or 0 if it cannot be read
+static inline uint64_t statsFileSize(const char *filename) {
+	struct stat st;
+	return stat(filename, &st) == 0 ? (uint64_t)st.st_size : 0;
+}
+
+// Peak resident set size of the process in bytes, or -1 if unknown
+static inline int64_t statsPeakRSS(void) {
+#if defined(__unix__) || defined(__APPLE__)
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#ifdef __APPLE__
+	return usage.ru_maxrss;
+#else
+	return (int64_t)usage.ru_maxrss * 1024;
+#endif
+#else
+	return -1;
+#endif
+}
+
+/*
+	statsPrint : Writes the statistics to stderr as one JSON object. Histogram buckets are
+				 listed by their exclusive upper bound in nanoseconds, and only when not empty.
+*/
+static inline void statsPrint(Stats *stats, const char *tool) {
+	if(!stats) return;
+	uint64_t totalNs = statsNow() - stats->startNs;
+	int64_t peakRSS = statsPeakRSS();
+
+	fprintf(stderr, "{\"tool\": \"%s\", \"total_ns\": %llu, \"stages\": {", tool, (unsigned long long)totalNs);
+	for(int i = 0; i < stats->stageCount; i++) {
+		fprintf(stderr, "%s\"%s\": %llu", i ? ", " : "", stats->stages[i].name, (unsigned long long)stats->stages[i].ns);
+	}
+	fprintf(stderr, "}, \"bytes_read\": %llu, \"bytes_written\": %llu, \"pixels\": %llu, \"mpix_per_s\": %.3f, ",
+		(unsigned long long)stats->bytesRead, (unsigned long long)stats->bytesWritten, (unsigned long long)stats->pixels,
+		totalNs ? stats->pixels * 1e3 / totalNs : 0);
+	if(peakRSS < 0) fprintf(stderr, "\"peak_rss_bytes\": null");
+	else fprintf(stderr, "\"peak_rss_bytes\": %lld", (long long)peakRSS);
+
+	if(stats->histogramCount) {
+		fprintf(stderr, ", \"histograms\": {");
+		for(int i = 0; i < stats->histogramCount; i++) {
+			StatsHistogram *histogram = &stats->histograms[i];
+			fprintf(stderr, "%s\"%s\": {\"count\": %llu, \"min_ns\": %llu, \"mean_ns\": %llu, \"max_ns\": %llu, \"buckets\": [",
+				i ? ", " : "", histogram->name, (unsigned long long)histogram->count, (unsigned long long)histogram->minNs,
+				(unsigned long long)(histogram->totalNs / histogram->count), (unsigned long long)histogram->maxNs);
+			int first = 1;
+			for(int bucket = 0; bucket < STATS_BUCKETS; bucket++) {
+				if(!histogram->buckets[bucket]) continue;
+				fprintf(stderr, "%s{\"lt_ns\": %llu, \"count\": %llu}", first ? "" : ", ",
+					(unsigned long long)1 << bucket, (unsigned long long)histogram->buckets[bucket]);
+				first = 0;
+			}
+			fprintf(stderr, "]}");
+		}
+		fprintf(stderr, "}");
+	}
+	fprintf(stderr, "}\n");
+}
+
+#endif
@@ -436,6 +436,22 @@ STBIDEF void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert);
 // flip the image vertically, so the first pixel in the output array is the bottom left
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+// decode JPEG images at 1/2, 1/4 or 1/8 of their size (scale_shift 1, 2 or 3)
+// by running a reduced IDCT on each block; at 1/8 only the DC coefficient is
+// used. interlaced PNG images are reduced by decoding only the Adam7 passes
+// that fall on the 2x2, 4x4 or 8x8 pixel grid (passes 1-5, 1-3 or just 1),
+// which are point samples rather than averages. the returned dimensions are
+// the reduced ones, rounded up. 0 (default) decodes at full size. stbi_info
+// always reports the full size.
+STBIDEF void stbi_set_downscale_on_load(int scale_shift);
+
+// stop decoding progressive JPEG images as soon as every component has
+// received, down to their last refinement bit, all the coefficients the
+// output scale uses (just the DC at 1/8 scale); later scans are not parsed
+// at all. the result is the same as a complete decode at that scale, so at
+// full scale nothing is skipped
+STBIDEF void stbi_set_progressive_early_stop_on_load(int flag_true_if_should_stop);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -952,6 +968,20 @@ STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
     stbi__vertically_flip_on_load = flag_true_if_should_flip;
 }
 
+static int stbi__downscale_shift = 0;
+
+STBIDEF void stbi_set_downscale_on_load(int scale_shift)
+{
+    stbi__downscale_shift = scale_shift < 0 ? 0 : scale_shift > 3 ? 3 : scale_shift;
+}
+
+static int stbi__progressive_early_stop = 0;
+
+STBIDEF void stbi_set_progressive_early_stop_on_load(int flag_true_if_should_stop)
+{
+    stbi__progressive_early_stop = flag_true_if_should_stop;
+}
+
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
    memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1696,6 +1726,9 @@ typedef struct
 
    int scan_n, order[4];
    int restart_interval, todo;
+   int scale_shift;  // log2 of the downscale factor, see stbi_set_downscale_on_load
+   int early_stop;   // see stbi_set_progressive_early_stop_on_load
+   stbi_uc coeff_seen[4][64]; // progressive only: zigzag coefficients received at full precision
 
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
@@ -2211,6 +2244,64 @@ static void stbi__idct_block(stbi_uc *out, int out_stride, short data[64])
    }
 }
 
+// reduced-size IDCTs for stbi_set_downscale_on_load. each output pixel is
+// the average of the 2x2 (4x4 output) or 4x4 (2x2 output) pixels the full
+// IDCT would produce, computed from the low-frequency coefficients only.
+// coef[x][u] = 1/f * sum_k C(u)/2 * cos((2*(x*f+k)+1)*u*pi/16), f = 8/n
+static const int stbi__idct_4x4_coef[4][4] = {
+   { stbi__f2f(0.353553391f), stbi__f2f( 0.453063723f), stbi__f2f( 0.326640741f), stbi__f2f( 0.159094823f) },
+   { stbi__f2f(0.353553391f), stbi__f2f( 0.187665139f), stbi__f2f(-0.326640741f), stbi__f2f(-0.384088878f) },
+   { stbi__f2f(0.353553391f), stbi__f2f(-0.187665139f), stbi__f2f(-0.326640741f), stbi__f2f( 0.384088878f) },
+   { stbi__f2f(0.353553391f), stbi__f2f(-0.453063723f), stbi__f2f( 0.326640741f), stbi__f2f(-0.159094823f) },
+};
+
+static const int stbi__idct_2x2_coef[2][2] = {
+   { stbi__f2f(0.353553391f), stbi__f2f( 0.320364431f) },
+   { stbi__f2f(0.353553391f), stbi__f2f(-0.320364431f) },
+};
+
+static void stbi__idct_reduced(stbi_uc *out, int out_stride, short data[64], const int *coef, int n)
+{
+   int x,y,u,v,val[16];
+
+   // columns: only the top-left n x n coefficients contribute
+   for (y=0; y < n; ++y) {
+      for (u=0; u < n; ++u) {
+         int sum = 0;
+         for (v=0; v < n; ++v)
+            sum += coef[y*n+v] * data[v*8+u];
+         val[y*n+u] = (sum + 512) >> 10;
+      }
+   }
+
+   // rows: 1<<12 from each pass minus the 10 bits removed above leaves 1<<14
+   for (y=0; y < n; ++y, out += out_stride) {
+      for (x=0; x < n; ++x) {
+         int sum = 8192 + (128<<14);
+         for (u=0; u < n; ++u)
+            sum += coef[x*n+u] * val[y*n+u];
+         out[x] = stbi__clamp(sum >> 14);
+      }
+   }
+}
+
+static void stbi__idct_block_4x4(stbi_uc *out, int out_stride, short data[64])
+{
+   stbi__idct_reduced(out, out_stride, data, &stbi__idct_4x4_coef[0][0], 4);
+}
+
+static void stbi__idct_block_2x2(stbi_uc *out, int out_stride, short data[64])
+{
+   stbi__idct_reduced(out, out_stride, data, &stbi__idct_2x2_coef[0][0], 2);
+}
+
+static void stbi__idct_block_1x1(stbi_uc *out, int out_stride, short data[64])
+{
+   // the DC term alone is the block average, scaled by 8
+   STBI_NOTUSED(out_stride);
+   out[0] = stbi__clamp(((data[0] + 4) >> 3) + 128);
+}
+
 #ifdef STBI_SSE2
 // sse2 integer IDCT. not the fastest possible implementation but it
 // produces bit-identical results to the generic C version so it's
@@ -2652,7 +2743,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
                if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               z->idct_block_kernel(z->img_comp[n].data+((z->img_comp[n].w2*j+i)<<(3-z->scale_shift)), z->img_comp[n].w2, data);
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2676,8 +2767,8 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                   // by the basic H and V specified for the component
                   for (y=0; y < z->img_comp[n].v; ++y) {
                      for (x=0; x < z->img_comp[n].h; ++x) {
-                        int x2 = (i*z->img_comp[n].h + x)*8;
-                        int y2 = (j*z->img_comp[n].v + y)*8;
+                        int x2 = (i*z->img_comp[n].h + x) << (3-z->scale_shift);
+                        int y2 = (j*z->img_comp[n].v + y) << (3-z->scale_shift);
                         int ha = z->img_comp[n].ha;
                         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
                         z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
@@ -2777,7 +2868,7 @@ static void stbi__jpeg_finish(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               z->idct_block_kernel(z->img_comp[n].data+((z->img_comp[n].w2*j+i)<<(3-z->scale_shift)), z->img_comp[n].w2, data);
             }
          }
       }
@@ -3007,8 +3098,10 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       //
       // img_mcu_x, img_mcu_y: <=17 bits; comp[i].h and .v are <=4 (checked earlier)
       // so these muls can't overflow with 32-bit ints (which we require)
-      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * 8;
-      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * 8;
+      //
+      // when downscaling, each 8x8 block decodes to (8>>scale_shift) pixels square
+      z->img_comp[i].w2 = (z->img_mcu_x * z->img_comp[i].h * 8) >> z->scale_shift;
+      z->img_comp[i].h2 = (z->img_mcu_y * z->img_comp[i].v * 8) >> z->scale_shift;
       z->img_comp[i].coeff = 0;
       z->img_comp[i].raw_coeff = 0;
       z->img_comp[i].linebuf = NULL;
@@ -3018,10 +3111,10 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       // align blocks for idct using mmx/sse
       z->img_comp[i].data = (stbi_uc*) (((size_t) z->img_comp[i].raw_data + 15) & ~15);
       if (z->progressive) {
-         // w2, h2 are multiples of 8 (see above)
-         z->img_comp[i].coeff_w = z->img_comp[i].w2 / 8;
-         z->img_comp[i].coeff_h = z->img_comp[i].h2 / 8;
-         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].w2, z->img_comp[i].h2, sizeof(short), 15);
+         // one 8x8 coefficient block per full-size block, whatever the output scale
+         z->img_comp[i].coeff_w = z->img_mcu_x * z->img_comp[i].h;
+         z->img_comp[i].coeff_h = z->img_mcu_y * z->img_comp[i].v;
+         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].coeff_w * 8, z->img_comp[i].coeff_h * 8, sizeof(short), 15);
          if (z->img_comp[i].raw_coeff == NULL)
             return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
          z->img_comp[i].coeff = (short*) (((size_t) z->img_comp[i].raw_coeff + 15) & ~15);
@@ -3064,6 +3157,26 @@ static int stbi__decode_jpeg_header(stbi__jpeg *z, int scan)
    return 1;
 }
 
+// record the spectral band of the scan just decoded, and report whether
+// every component now has all the coefficients the output scale needs
+static int stbi__jpeg_scan_completes_image(stbi__jpeg *j)
+{
+   int i,k,n = 8 >> j->scale_shift;
+   // a scan with a nonzero Al leaves low-order bits for a later refinement scan
+   if (j->succ_low == 0)
+      for (i=0; i < j->scan_n; ++i)
+         for (k=j->spec_start; k <= j->spec_end; ++k)
+            j->coeff_seen[j->order[i]][k] = 1;
+   for (i=0; i < j->s->img_n; ++i) {
+      for (k=0; k < 64; ++k) {
+         int zig = stbi__jpeg_dezigzag[k];
+         if ((zig & 7) < n && (zig >> 3) < n && !j->coeff_seen[i][k])
+            return 0;
+      }
+   }
+   return 1;
+}
+
 // decode image to YCbCr format
 static int stbi__decode_jpeg_image(stbi__jpeg *j)
 {
@@ -3073,12 +3186,15 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
       j->img_comp[m].raw_coeff = NULL;
    }
    j->restart_interval = 0;
+   memset(j->coeff_seen, 0, sizeof(j->coeff_seen));
    if (!stbi__decode_jpeg_header(j, STBI__SCAN_load)) return 0;
    m = stbi__get_marker(j);
    while (!stbi__EOI(m)) {
       if (stbi__SOS(m)) {
          if (!stbi__process_scan_header(j)) return 0;
          if (!stbi__parse_entropy_coded_data(j)) return 0;
+         if (j->progressive && j->early_stop && stbi__jpeg_scan_completes_image(j))
+            break;
          if (j->marker == STBI__MARKER_none ) {
             // handle 0s at the end of image data from IP Kamera 9060
             while (!stbi__at_eof(j->s)) {
@@ -3479,6 +3595,8 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
+   j->scale_shift = 0;
+   j->early_stop = 0;
    j->idct_block_kernel = stbi__idct_block;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
@@ -3532,6 +3650,17 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // load a jpeg image from whichever source, but leave in YCbCr format
    if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
 
+   // from here on everything works on the reduced-size component planes
+   if (z->scale_shift) {
+      int round = (1 << z->scale_shift) - 1;
+      z->s->img_x = (z->s->img_x + round) >> z->scale_shift;
+      z->s->img_y = (z->s->img_y + round) >> z->scale_shift;
+      for (n=0; n < z->s->img_n; ++n) {
+         z->img_comp[n].x = (z->img_comp[n].x + round) >> z->scale_shift;
+         z->img_comp[n].y = (z->img_comp[n].y + round) >> z->scale_shift;
+      }
+   }
+
    // determine actual number of components to generate
    n = req_comp ? req_comp : z->s->img_n >= 3 ? 3 : 1;
 
@@ -3687,6 +3816,11 @@ static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int re
    STBI_NOTUSED(ri);
    j->s = s;
    stbi__setup_jpeg(j);
+   j->scale_shift = stbi__downscale_shift;
+   j->early_stop = stbi__progressive_early_stop;
+   if      (j->scale_shift == 1) j->idct_block_kernel = stbi__idct_block_4x4;
+   else if (j->scale_shift == 2) j->idct_block_kernel = stbi__idct_block_2x2;
+   else if (j->scale_shift == 3) j->idct_block_kernel = stbi__idct_block_1x1;
    result = load_jpeg_image(j, x,y,comp,req_comp);
    STBI_FREE(j);
    return result;
@@ -4126,6 +4260,24 @@ static int stbi__do_zlib(stbi__zbuf *a, char *obuf, int olen, int exp, int parse
    return stbi__parse_zlib(a, parse_header);
 }
 
+// inflate only the first outlen bytes of a stream. the buffer has room for
+// one maximum-length match past outlen, so running out of room there means
+// the prefix is complete; returns NULL if the stream ended or failed first
+static char *stbi__zlib_decode_prefix(const char *buffer, int len, int outlen, int parse_header)
+{
+   stbi__zbuf a;
+   char *p = (char *) stbi__malloc_mad2(1, outlen, 258);
+   if (p == NULL) return NULL;
+   a.zbuffer = (stbi_uc *) buffer;
+   a.zbuffer_end = (stbi_uc *) buffer + len;
+   stbi__do_zlib(&a, p, outlen + 258, 0, parse_header);
+   if (a.zout - a.zout_start < outlen) {
+      STBI_FREE(p);
+      return NULL;
+   }
+   return p;
+}
+
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen)
 {
    stbi__zbuf a;
@@ -4241,6 +4393,7 @@ typedef struct
    stbi__context *s;
    stbi_uc *idata, *expanded, *out;
    int depth;
+   int scale_shift; // interlaced only, see stbi_set_downscale_on_load
 } stbi__png;
 
 
@@ -4489,18 +4642,34 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    return 1;
 }
 
+static int stbi__png_pass_len(stbi__png *a, int pass, int depth)
+{
+   static int xorig[] = { 0,4,0,2,0,1,0 };
+   static int yorig[] = { 0,0,4,0,2,0,1 };
+   static int xspc[]  = { 8,8,4,4,2,2,1 };
+   static int yspc[]  = { 8,8,8,4,4,2,2 };
+   int x = (a->s->img_x - xorig[pass] + xspc[pass]-1) / xspc[pass];
+   int y = (a->s->img_y - yorig[pass] + yspc[pass]-1) / yspc[pass];
+   if (!x || !y) return 0;
+   return ((((a->s->img_n * x * depth) + 7) >> 3) + 1) * y;
+}
+
 static int stbi__create_png_image(stbi__png *a, stbi_uc *image_data, stbi__uint32 image_data_len, int out_n, int depth, int color, int interlaced)
 {
    int bytes = (depth == 16 ? 2 : 1);
    int out_bytes = out_n * bytes;
    stbi_uc *final;
-   int p;
+   int p, passes, out_w, out_h;
    if (!interlaced)
       return stbi__create_png_image_raw(a, image_data, image_data_len, out_n, a->s->img_x, a->s->img_y, depth, color);
 
-   // de-interlacing
-   final = (stbi_uc *) stbi__malloc_mad3(a->s->img_x, a->s->img_y, out_bytes, 0);
-   for (p=0; p < 7; ++p) {
+   // de-interlacing; when downscaling, the first 7-2*scale_shift passes
+   // cover exactly the pixels on the 1<<scale_shift grid
+   passes = 7 - 2*a->scale_shift;
+   out_w = (a->s->img_x + (1 << a->scale_shift)-1) >> a->scale_shift;
+   out_h = (a->s->img_y + (1 << a->scale_shift)-1) >> a->scale_shift;
+   final = (stbi_uc *) stbi__malloc_mad3(out_w, out_h, out_bytes, 0);
+   for (p=0; p < passes; ++p) {
       int xorig[] = { 0,4,0,2,0,1,0 };
       int yorig[] = { 0,0,4,0,2,0,1 };
       int xspc[]  = { 8,8,4,4,2,2,1 };
@@ -4510,16 +4679,16 @@ static int stbi__create_png_image(stbi__png *a, stbi_uc *image_data, stbi__uint3
       x = (a->s->img_x - xorig[p] + xspc[p]-1) / xspc[p];
       y = (a->s->img_y - yorig[p] + yspc[p]-1) / yspc[p];
       if (x && y) {
-         stbi__uint32 img_len = ((((a->s->img_n * x * depth) + 7) >> 3) + 1) * y;
+         stbi__uint32 img_len = stbi__png_pass_len(a, p, depth);
          if (!stbi__create_png_image_raw(a, image_data, image_data_len, out_n, x, y, depth, color)) {
             STBI_FREE(final);
             return 0;
          }
          for (j=0; j < y; ++j) {
             for (i=0; i < x; ++i) {
-               int out_y = j*yspc[p]+yorig[p];
-               int out_x = i*xspc[p]+xorig[p];
-               memcpy(final + out_y*a->s->img_x*out_bytes + out_x*out_bytes,
+               int out_y = (j*yspc[p]+yorig[p]) >> a->scale_shift;
+               int out_x = (i*xspc[p]+xorig[p]) >> a->scale_shift;
+               memcpy(final + out_y*out_w*out_bytes + out_x*out_bytes,
                       a->out + (j*x+i)*out_bytes, out_bytes);
             }
          }
@@ -4529,6 +4698,8 @@ static int stbi__create_png_image(stbi__png *a, stbi_uc *image_data, stbi__uint3
       }
    }
    a->out = final;
+   a->s->img_x = out_w;
+   a->s->img_y = out_h;
 
    return 1;
 }
@@ -4792,10 +4963,22 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
             if (first) return stbi__err("first not IHDR", "Corrupt PNG");
             if (scan != STBI__SCAN_load) return 1;
             if (z->idata == NULL) return stbi__err("no IDAT","Corrupt PNG");
-            // initial guess for decoded data size to avoid unnecessary reallocs
-            bpl = (s->img_x * z->depth + 7) / 8; // bytes per line, per component
-            raw_len = bpl * s->img_y * s->img_n /* pixels */ + s->img_y /* filter mode per row */;
-            z->expanded = (stbi_uc *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, ioff, raw_len, (int *) &raw_len, !is_iphone);
+            if (!interlace) z->scale_shift = 0;
+            if (z->scale_shift) {
+               // the passes are stored in order, so inflate just the early ones
+               int p;
+               raw_len = 0;
+               for (p=0; p < 7 - 2*z->scale_shift; ++p)
+                  raw_len += stbi__png_pass_len(z, p, z->depth);
+               z->expanded = (stbi_uc *) stbi__zlib_decode_prefix((char *) z->idata, ioff, raw_len, !is_iphone);
+               if (z->expanded == NULL) z->scale_shift = 0; // fall back to the whole image
+            }
+            if (!z->scale_shift) {
+               // initial guess for decoded data size to avoid unnecessary reallocs
+               bpl = (s->img_x * z->depth + 7) / 8; // bytes per line, per component
+               raw_len = bpl * s->img_y * s->img_n /* pixels */ + s->img_y /* filter mode per row */;
+               z->expanded = (stbi_uc *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, ioff, raw_len, (int *) &raw_len, !is_iphone);
+            }
             if (z->expanded == NULL) return 0; // zlib should set error
             STBI_FREE(z->idata); z->idata = NULL;
             if ((req_comp == s->img_n+1 && req_comp != 3 && !pal_img_n) || has_trans)
@@ -4880,6 +5063,7 @@ static void *stbi__png_load(stbi__context *s, int *x, int *y, int *comp, int req
 {
    stbi__png p;
    p.s = s;
+   p.scale_shift = stbi__downscale_shift;
    return stbi__do_png(&p, x,y,comp,req_comp, ri);
 }
 
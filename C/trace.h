@@ -0,0 +1,92 @@
+#ifndef __BLURHASH_TRACE_H__
+#define __BLURHASH_TRACE_H__
+
+#include "counters.h"
+
+/*
+	Hooks at the start and end of every public encoder and decoder entry point.
+	Without build flags they expand to nothing and their arguments are never
+	evaluated.
+
+	With BLURHASH_USDT defined (make USDT=1), they fire USDT probes for
+	bpftrace, perf or SystemTap under the provider name blurhash. This needs
+	<sys/sdt.h> from systemtap-sdt-dev. An unattached probe is a single nop.
+
+	encode__start(const char *mode, int width, int height, int xComponents, int yComponents, int count)
+		Fires once per call, before the arguments are checked. count is the number
+		of images or component counts for the batch calls, otherwise 1.
+	encode__end(const char *mode, int result, const char *hash)
+		result is 0 on success and -1 on error, including invalid arguments. hash is
+		the (first) result, or NULL on failure and for blurHashFactorsForPixels.
+	decode__start(const char *mode, const char *hash, int width, int height, int count)
+		hash is the first hash of a batch, or NULL for an empty one.
+	decode__end(const char *mode, int result)
+		result is 0 on success, -2 for an invalid hash and -1 for other errors.
+
+	mode is one of the BlurHashMode names from counters.h. The library has no
+	caches, so there are no cache probes.
+
+	With BLURHASH_METRICS defined (make METRICS=1), the end hooks also count the
+	call in the registry of metrics.c. A start hook declares a local variable
+	for this, so the matching end hooks have to be in its scope; the streaming
+	encoder carries it from one call to the next with TRACE_SAVE and TRACE_RESTORE.
+*/
+
+#ifdef BLURHASH_USDT
+
+#include <sys/sdt.h>
+
+#define USDT_ENCODE_START(mode, width, height, xComponents, yComponents, count) \
+	DTRACE_PROBE6(blurhash, encode__start, blurHashModeName(mode), width, height, xComponents, yComponents, count)
+#define USDT_ENCODE_END(mode, result, hash) \
+	DTRACE_PROBE3(blurhash, encode__end, blurHashModeName(mode), result, hash)
+#define USDT_DECODE_START(mode, hash, width, height, count) \
+	DTRACE_PROBE5(blurhash, decode__start, blurHashModeName(mode), hash, width, height, count)
+#define USDT_DECODE_END(mode, result) \
+	DTRACE_PROBE2(blurhash, decode__end, blurHashModeName(mode), result)
+
+#else
+
+#define USDT_ENCODE_START(mode, width, height, xComponents, yComponents, count) ((void)0)
+#define USDT_ENCODE_END(mode, result, hash) ((void)0)
+#define USDT_DECODE_START(mode, hash, width, height, count) ((void)0)
+#define USDT_DECODE_END(mode, result) ((void)0)
+
+#endif
+
+#ifdef BLURHASH_METRICS
+
+typedef struct {
+	uint64_t startNs, pixels;
+} TraceScope;
+
+#define METRICS_START(width, height, count) \
+	TraceScope traceScope = { blurHashMetricsNow(), (uint64_t)(width) * (height) * (count) }
+#define METRICS_END(op, mode, result) \
+	blurHashMetricsRecord(op, mode, result, traceScope.pixels, blurHashMetricsNow() - traceScope.startNs)
+#define TRACE_SAVE(scope) ((scope) = traceScope)
+#define TRACE_RESTORE(scope) TraceScope traceScope = (scope)
+
+#else
+
+#define METRICS_START(width, height, count) ((void)0)
+#define METRICS_END(op, mode, result) ((void)0)
+#define TRACE_SAVE(scope) ((void)0)
+#define TRACE_RESTORE(scope) ((void)0)
+
+#endif
+
+#define TRACE_ENCODE_START(mode, width, height, xComponents, yComponents, count) \
+	METRICS_START(width, height, count); \
+	USDT_ENCODE_START(mode, width, height, xComponents, yComponents, count)
+#define TRACE_ENCODE_END(mode, result, hash) \
+	METRICS_END(BLURHASH_ENCODE, mode, result); \
+	USDT_ENCODE_END(mode, result, hash)
+#define TRACE_DECODE_START(mode, hash, width, height, count) \
+	METRICS_START(width, height, count); \
+	USDT_DECODE_START(mode, hash, width, height, count)
+#define TRACE_DECODE_END(mode, result) \
+	METRICS_END(BLURHASH_DECODE, mode, result); \
+	USDT_DECODE_END(mode, result)
+
+#endif